@@ -22,10 +22,20 @@ PAGE 1 : /* Data memory. This is a legacy description since the C28 has a unifie
    RAMGS7           : origin = 0x013000, length = 0x001000
 */
 
+/*
+   RAMLS5           : origin = 0x00A800, length = 0x000800
+*/
+
 /*
    CPU2TOCPU1RAM    : origin = 0x03F800, length = 0x000400
    CPU1TOCPU2RAM    : origin = 0x03FC00, length = 0x000400
 */
+
+/*
+   apipc mailboxes take the last APIPC_MBOX_SIZE words of each MSGRAM block,
+   CPU2TOCPU1RAM & CPU1TOCPU2RAM lengths should be shrinked to 0x0003F4,
+   the APIPC_CREDIT_SIZE credits words sit under each mailbox.
+*/
 }
 
 SECTIONS
@@ -44,6 +54,8 @@ SECTIONS
          .cpur_cpul_addr              
    }
 
+   .apipc_ctl                 : > RAMLS5,       PAGE = 1  /* local objs control state, core dedicated RAM */
+
     /*
        The following section definitions are required when using the IPC API Drivers
        Take care to check that groups aren't already defined at the provided
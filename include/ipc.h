@@ -14,7 +14,11 @@
 #ifndef __IPC_H__
 #define __IPC_H__
 
+#if APIPC_POSIX
+#include "ipc_posix.h"
+#else
 #include "F2837xD_Ipc_drivers.h"
+#endif
 
 #include "ipc_defs.h"
 #include "ipc_utils.h"
@@ -30,6 +34,28 @@
 extern volatile tIpcController g_sIpcController1;
 extern volatile tIpcController g_sIpcController2;
 
+/**
+ * \brief apipc additional link configuration
+ *
+ * Describes the spaces & IPC driver controllers apipc uses to reach a peer
+ * other than the CPU1 - CPU2 one. Objs tables hold APIPC_MAX_OBJ descriptors
+ * each and, as the staging pool, must be readable by the peer.
+ */
+struct apipc_link_cfg
+{
+    struct apipc_obj *l_obj; /**< local objs table, read by the peer */
+    struct apipc_obj *r_obj; /**< peer objs table */
+    uint16_t *pdata; /**< staging pool */
+    size_t data_len; /**< staging pool length in words */
+    volatile tIpcController *pctrl[APIPC_MAX_LANE]; /**< lanes IPC driver
+                                                      controllers */
+    uint32_t irq_flag[APIPC_MAX_LANE]; /**< lanes ipc interrupt flags */
+    volatile struct apipc_credit *l_credit; /**< local credits, read by the
+                                              peer. NULL disables the link
+                                              flow control */
+    volatile struct apipc_credit *r_credit; /**< peer credits */
+};
+
 /**
  * \brief Initialize apipc IPC API
  *
@@ -42,14 +68,53 @@ extern volatile tIpcController g_sIpcController2;
  *
  * Funtion take care not only to initialize apipc but also ipc driver by
  * calling InitIpc() and initializing ipc driver controllers on IPC_INT0 &
- * IPC_INT1 respectively.
+ * IPC_INT1 respectively. Each controller is used as an independent apipc lane.
  *
  * \note apipc_init will acknowledge the api local start and will wait until it
  * were also initiated on the Remote CPU blocking the process meanwhile. Fuction
- * is blocking. 
+ * is blocking. See apipc_init_start() & apipc_init_step() for a non blocking
+ * initialization.
  */
 void apipc_init(void);
 
+/**
+ * \brief Start a non blocking apipc initialization
+ *
+ * \param[in] timeout ipc free-running counter ticks apipc_init_step() will
+ * wait the remote core before reporting APIPC_RC_TIMEOUT. 0 waits forever.
+ * See IPC_TIMER_WAIT_xxxmS.
+ *
+ * Initializes the ipc driver the same way apipc_init() does but, instead of
+ * spinning until the remote core gets inited, returns immediately. The
+ * application is then free to set up peripherals meanwhile and should call
+ * apipc_init_step() until it returns APIPC_RC_SUCCESS.
+ */
+void apipc_init_start(uint64_t timeout);
+
+/**
+ * \brief Evolve a non blocking apipc initialization
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS once apipc is inited on both cores,
+ * APIPC_RC_PENDING while the remote core is still being waited,
+ * APIPC_RC_TIMEOUT if it is being waited for longer than apipc_init_start()
+ * timeout and APIPC_RC_FAIL if apipc_init_start() wasn't called.
+ *
+ * Every call checks the remote core progress without blocking. Initialization
+ * keeps evolving after a timeout was reported, so the application decides
+ * whether to keep waiting or to give up.
+ *
+ * \note Objects could be registered once apipc_init_state() went further than
+ * APIPC_INIT_SM_SRAM_ACCES.
+ */
+enum apipc_rc apipc_init_step(void);
+
+/**
+ * \brief peep actual apipc initialization state
+ *
+ * \return apipc_init_sm actual initialization sm state
+ */
+enum apipc_init_sm apipc_init_state(void);
+
 /**
  * @brief Register an apipc IPC API object
  *
@@ -70,10 +135,287 @@ void apipc_init(void);
  * Registration will fail if paddr == NULL. Multiple objects registration over
  * the same obj_idx will cause overwriting. 
  *
+ * APIPC_OBJ_TYPE_BLOCK objects larger than APIPC_STREAM_CHUNK words are
+ * streamed in fragments, so they aren't limited by cl_r_w_data length.
+ *
+ * APIPC_OBJ_TYPE_DATA & APIPC_OBJ_TYPE_FLAGS objects are 16 or 32 bits long.
+ * APIPC_OBJ_TYPE_INLINE objects, up to APIPC_INLINE_WORDS words, travel on a
+ * single command without staging, their registration fails if size is longer.
+ *
  */
 enum apipc_rc apipc_register_obj(uint16_t obj_idx, enum apipc_obj_type obj_type,
                                  void *paddr, size_t size, uint16_t startup);
 
+/**
+ * @brief Register a triple buffered snapshot object on the receiving core
+ *
+ * \param[in] obj_idx object index number
+ * \param[in] pbufs pointer to three contiguous buffers of size words each
+ * \param[in] size one buffer size in words
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if registration process success and
+ * APIPC_RC_FAIL if object couldn be registered.
+ *
+ * The transmitting core registers the same obj_idx as APIPC_OBJ_TYPE_SNAPSHOT
+ * over his source data. Every write lands on the buffer neither the reader
+ * holds nor is published, and it is published with an index swap once the
+ * whole block landed. The reader takes the latest published buffer with
+ * apipc_snapshot_acquire(), never torn, without blocking nor copying.
+ *
+ * \note Snapshot objects are one way, the receiving core never transmits them.
+ */
+enum apipc_rc apipc_register_snapshot(uint16_t obj_idx, void *pbufs, size_t size);
+
+/**
+ * @brief Acquire the latest snapshot
+ *
+ * \param[in] obj_idx snapshot object index number
+ *
+ * \return pointer to the latest published snapshot, NULL if obj_idx isn't a
+ * receiving snapshot.
+ *
+ * The returned buffer stays untouched until apipc_snapshot_release() is
+ * called. Acquiring again before releasing returns the same buffer.
+ *
+ * \note Function never blocks and could be called from interrupt context.
+ */
+const void *apipc_snapshot_acquire(uint16_t obj_idx);
+
+/**
+ * @brief Release the acquired snapshot
+ *
+ * \param[in] obj_idx snapshot object index number
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS, APIPC_RC_FAIL if obj_idx isn't a
+ * receiving snapshot.
+ *
+ * Next apipc_snapshot_acquire() call takes a newer snapshot if one was
+ * published meanwhile.
+ */
+enum apipc_rc apipc_snapshot_release(uint16_t obj_idx);
+
+/**
+ * @brief Assign an apipc object to a transport lane
+ *
+ * \param[in] obj_idx object index number 
+ * \param[in] lane lane the object will be transmitted on. APIPC_LANE_AUTO lets
+ * apipc put every transmition on the least loaded lane.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the lane was assigned, APIPC_RC_FAIL if
+ * obj_idx or lane are out of range.
+ *
+ * Objects are registered as APIPC_LANE_AUTO. Pinning latency sensitive objects
+ * to a lane and bulk ones to the other isolates them from each other.
+ *
+ * \note The new lane takes effect on the next obj transmition.
+ */
+enum apipc_rc apipc_obj_set_lane(uint16_t obj_idx, enum apipc_lane_id lane);
+
+/**
+ * @brief Enable delta transmitions on a block object
+ *
+ * \param[in] obj_idx object index number 
+ * \param[in] pshadow pointer to a local buffer of the object size apipc keeps
+ * the last transmitted image on. NULL disables delta transmitions.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if delta mode was set, APIPC_RC_FAIL if
+ * the object isn't a registered APIPC_OBJ_TYPE_BLOCK or is longer than
+ * APIPC_STREAM_CHUNK words.
+ *
+ * On delta mode only the word runs that changed since the last transmition
+ * are packed on cl_r_w_data and patched in place by the remote core. When the
+ * packed runs are dense, see APIPC_DELTA_DENSE, or the last transmition
+ * failed, the whole block is transmitted instead. The first transmition is
+ * always a whole one. A block that didn't change completes without a
+ * transmition, the remote core rx hook isn't run.
+ *
+ * \note pshadow belongs to apipc while delta mode is enabled.
+ */
+enum apipc_rc apipc_obj_set_delta(uint16_t obj_idx, void *pshadow);
+
+/**
+ * @brief Enable CRC32 checked transmitions on a block object
+ *
+ * \param[in] obj_idx object index number
+ * \param[in] enable 1 to check every transmition, 0 to stop checking them
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the obj check was set, APIPC_RC_FAIL if
+ * the obj isn't a registered APIPC_OBJ_TYPE_BLOCK or APIPC_OBJ_TYPE_SNAPSHOT.
+ *
+ * The CRC32 is computed while the block is copied on cl_r_w_data, with no
+ * extra pass, and the remote core checks it before committing the block. A
+ * mismatch is answered right away and the obj retries his transmition.
+ *
+ * \note Delta transmitions are disabled on checked objs. Streamed fragments,
+ * APIPC_STREAM_CHUNK larger blocks, aren't checked.
+ */
+enum apipc_rc apipc_obj_set_crc(uint16_t obj_idx, uint16_t enable);
+
+/**
+ * @brief Consume an obj block writes in place on the receiving core
+ *
+ * \param[in] obj_idx object index number, registered on the receiving core
+ * \param[in] enable 1 to lease the transmitting core staging spaces, 0 to copy
+ * them on the obj again.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the obj lease was set, APIPC_RC_FAIL if
+ * the obj isn't a registered APIPC_OBJ_TYPE_BLOCK or is longer than
+ * APIPC_STREAM_CHUNK words.
+ *
+ * The transmitting core sees it on the obj descriptor and lends his
+ * cl_r_w_data staging space instead of having it copied, the obj local buffer
+ * is never written. The application reads it with apipc_lease_acquire() and
+ * gives it back with apipc_lease_release(), only then the transmitting core
+ * frees it. A block that lands before the last one was acquired replaces it.
+ *
+ * A lost lease write is retransmitted on the same staging space, and a lost
+ * release is put again until the transmitting core answers it. A staging
+ * space is freed anyway once its obj transmition fails.
+ *
+ * \note While the application holds a lease the transmitting core staging
+ * pool is shorter. When APIPC_LEASE_MAX spaces are lent, or the obj is
+ * transmitted with CRC32, delta or on an image, blocks are copied as usual.
+ */
+enum apipc_rc apipc_obj_set_lease(uint16_t obj_idx, uint16_t enable);
+
+/**
+ * @brief Acquire the newest leased block of an obj
+ *
+ * \param[in] obj_idx leased object index number
+ *
+ * \return read-only pointer to the block, NULL if no block landed since the
+ * last release or obj_idx isn't leased.
+ *
+ * Acquiring again before releasing returns the same block.
+ *
+ * \note Call it from the apipc_app() context, never from interrupts.
+ */
+const void *apipc_lease_acquire(uint16_t obj_idx);
+
+/**
+ * @brief Release the acquired leased block
+ *
+ * \param[in] obj_idx leased object index number
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS, APIPC_RC_FAIL if no block was acquired.
+ *
+ * \note Call it from the apipc_app() context, never from interrupts.
+ */
+enum apipc_rc apipc_lease_release(uint16_t obj_idx);
+
+/**
+ * @brief Set an obj as latency critical
+ *
+ * \param[in] obj_idx object index number
+ * \param[in] enable 1 to raise the remote interrupt on every obj put, 0 to let
+ * them be coalesced.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the obj was set, APIPC_RC_FAIL if
+ * obj_idx is out of range.
+ *
+ * Urgent objs bypass the interrupt coalescing, see APIPC_COALESCE_MSGS, so
+ * their latency doesn't depend on the bulk traffic sharing the lane.
+ *
+ * \note Should be called after the obj is registered.
+ */
+enum apipc_rc apipc_obj_set_urgent(uint16_t obj_idx, uint16_t enable);
+
+/**
+ * @brief Retrieve a transport lane statistics
+ *
+ * \param[in] lane lane to consult, APIPC_LANE_0 or APIPC_LANE_1
+ * \param[out] pstats pointer where lane statistics will be copied
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if statistics were copied, APIPC_RC_FAIL
+ * if lane is out of range or pstats == NULL.
+ */
+enum apipc_rc apipc_lane_stats(enum apipc_lane_id lane,
+                               struct apipc_lane_stats *pstats);
+
+/**
+ * @brief Retrieve a link transport lane statistics
+ *
+ * \param[in] link link to consult, APIPC_LINK_0 up to APIPC_MAX_LINK - 1
+ * \param[in] lane lane to consult, APIPC_LANE_0 or APIPC_LANE_1
+ * \param[out] pstats pointer where lane statistics will be copied
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if statistics were copied, APIPC_RC_FAIL
+ * if link or lane are out of range, the link wasn't registered or
+ * pstats == NULL.
+ *
+ * apipc_lane_stats() consults the APIPC_LINK_0 lanes.
+ */
+enum apipc_rc apipc_link_lane_stats(uint16_t link, enum apipc_lane_id lane,
+                                    struct apipc_lane_stats *pstats);
+
+/**
+ * @brief Register the link to an additional peer
+ *
+ * \param[in] link link id, 1 up to APIPC_MAX_LINK - 1
+ * \param[in] pcfg link spaces & controllers, copied by apipc
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the link was registered, APIPC_RC_FAIL
+ * if link is out of range, pcfg is incomplete or apipc was already started.
+ *
+ * Every link owns his objs tables, staging pool, lanes & received messages
+ * queues, so peers don't share budgets. Obj indexes are shared by every link
+ * though, see apipc_obj_set_link(). APIPC_LINK_0 is always the CPU1 - CPU2
+ * link and is configured by apipc itself.
+ *
+ * \note Should be called before apipc_init() or apipc_init_start(). The link
+ * lanes interrupts are owned by the port, which hands the received messages
+ * over through apipc_link_drain(). Images & remote procedure calls run on
+ * APIPC_LINK_0 only.
+ */
+enum apipc_rc apipc_link_register(uint16_t link, const struct apipc_link_cfg *pcfg);
+
+/**
+ * @brief Store the messages received on a link lane
+ *
+ * \param[in] link link id
+ * \param[in] lane lane the messages were received on
+ *
+ * Additional links interrupt handlers should call it the same way
+ * apipc_ipc0_isr_handler() & apipc_ipc1_isr_handler() serve APIPC_LINK_0.
+ */
+void apipc_link_drain(uint16_t link, enum apipc_lane_id lane);
+
+/**
+ * @brief Bind an apipc object to a link
+ *
+ * \param[in] obj_idx object index number
+ * \param[in] link link of the peer the object is transmitted to
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the obj was bound, APIPC_RC_FAIL if
+ * obj_idx or link are out of range, the link wasn't registered or the obj
+ * was already registered.
+ *
+ * Objects are bound to APIPC_LINK_0 by apipc_init(). Object indexes are one
+ * space shared by every link, an obj is published on the objs table of his
+ * link only. So links add lanes & staging pools but no objs, APIPC_MAX_OBJ
+ * objs are available in total however many links are registered.
+ *
+ * \note Should be called after apipc_init() and before the obj is registered.
+ */
+enum apipc_rc apipc_obj_set_link(uint16_t obj_idx, uint16_t link);
+
+/**
+ * @brief Register an obj receive hook
+ *
+ * \param[in] obj_idx object index number, registered on the receiving core
+ * \param[in] hook function run each time the remote core data lands on the
+ * obj, NULL unregisters it.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the hook was registered, APIPC_RC_FAIL
+ * if obj_idx is out of range or wasn't registered.
+ *
+ * The hook runs right after the local copy of a DATA, FLAGS, BLOCK, delta or
+ * image write completes, once the last fragment landed for streamed blocks.
+ * It runs from apipc_app(), or from apipc_poll() wherever the application
+ * calls it, an interrupt included on APIPC_POLLED builds.
+ */
+enum apipc_rc apipc_obj_set_rx_hook(uint16_t obj_idx, apipc_rx_hook hook);
+
 /**
  * @brief peep actual obj_sm state of obj_idx object 
  *
@@ -100,25 +442,88 @@ enum apipc_obj_sm apipc_obj_state(uint16_t obj_idx);
  * only if the object is ready to be transmited between cores. 
  *
  * \return apipc_rc APIPC_RC_SUCCESS if obj transmition process could be
- * successfully united. APIPC_RC_FAIL if object send process couldn be started.
+ * successfully united. APIPC_RC_BUSY if it was started but waits queued
+ * because the remote core is out of credits, see APIPC_CREDIT_RESERVE.
+ * APIPC_RC_FAIL if object send process couldn be started.
  *
  * \note Object should have already been inited to APIPC_OBJ_SM_IDLE 
 
  */
 enum apipc_rc apipc_send(uint16_t obj_idx);
 
+/**
+ * @brief start object transmition right away.
+ *
+ * \param[in] obj_idx object index number
+ *
+ * Like apipc_send(), but the obj is written on the ipc driver from the caller
+ * context instead of at the next apipc_app() call, when the obj lane has put
+ * buffer room, budget and credits. Otherwise the transmition is left to the
+ * obj state machine as apipc_send() does. The response and the retries are
+ * always handled by the obj state machine.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the obj was written and waits his
+ * response. APIPC_RC_PENDING if the transmition was left to the obj state
+ * machine. APIPC_RC_BUSY if it waits queued because the remote core is out of
+ * credits. APIPC_RC_FAIL if object send process couldn be started.
+ *
+ * \note Background loop only, as apipc_send().
+ */
+enum apipc_rc apipc_send_now(uint16_t obj_idx);
+
+/**
+ * @brief Request an object transfer from interrupt context
+ *
+ * \param[in] obj_idx object index number
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the obj was put or its transfer
+ * requested, APIPC_RC_FAIL if obj_idx is out of range or wasn't registered.
+ *
+ * apipc_send() must only be called from the background loop, it races with
+ * apipc_app(). apipc_send_isr() is the send a control interrupt calls: it never
+ * blocks and takes a bounded time. An idle obj enabled with
+ * apipc_obj_set_isr_push() is put on the ipc driver right away, if his lane has
+ * room and credits. Otherwise the request is recorded and apipc_app() starts
+ * the transfer once the obj is idle, requests made meanwhile are merged.
+ * apipc_app() also handles the response of a put obj and transmits it again
+ * through the obj sm if it doesn't arrive. apipc_send() of a put obj is merged
+ * as a request as well, the obj is transmitted again once his lane slot was
+ * given back.
+ */
+enum apipc_rc apipc_send_isr(uint16_t obj_idx);
+
+/**
+ * @brief Let apipc_send_isr() put an obj straight away
+ *
+ * \param[in] obj_idx object index number
+ * \param[in] enable 1 to put the obj from apipc_send_isr(), 0 to only request
+ * its transfer.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the obj was set, APIPC_RC_FAIL if the
+ * obj isn't a registered APIPC_OBJ_TYPE_DATA or APIPC_OBJ_TYPE_FLAGS.
+ *
+ * \note Should be called after the obj is registered, from the background
+ * loop.
+ */
+enum apipc_rc apipc_obj_set_isr_push(uint16_t obj_idx, uint16_t enable);
+
 /**
  * @brief Sets the designated bits at the remote obj.
  *
  * \param[in] obj_idx object index number 
  * \param[in] bmask especifies bits to be set.
  *
- * \return apipc_rc 
+ * \return apipc_rc APIPC_RC_SUCCESS if the command was put, APIPC_RC_BUSY if
+ * the lane has no budget or credits for it, APIPC_RC_FAIL otherwise.
  *
  * \note function bypass apipc normal functioning and obj sm interacting
  * directly with ipc diver. Use is not recomended!
  *
  * \note hint! could be used to announce a flagiged event immediately .
+ *
+ * \note The command holds a lane slot until its response. While an obj write
+ * or bits command waits its response, the next ones are put on its lane, so
+ * the remote core applies them in order.
  */
 enum apipc_rc apipc_flags_set_bits(uint16_t obj_idx, uint32_t bmask);
 
@@ -128,12 +533,17 @@ enum apipc_rc apipc_flags_set_bits(uint16_t obj_idx, uint32_t bmask);
  * \param[in] obj_idx object index number 
  * \param[in] bmask especifies bits to be clear.
  *
- * \return apipc_rc 
+ * \return apipc_rc APIPC_RC_SUCCESS if the command was put, APIPC_RC_BUSY if
+ * the lane has no budget or credits for it, APIPC_RC_FAIL otherwise.
  *
  * \note function bypass apipc normal functioning and obj sm interacting
  * directly with ipc diver. Use is not recomended!
  *
  * \note hint! could be used to announce a flagiged event immediately .
+ *
+ * \note The command holds a lane slot until its response. While an obj write
+ * or bits command waits its response, the next ones are put on its lane, so
+ * the remote core applies them in order.
  */
 enum apipc_rc apipc_flags_clear_bits(uint16_t obj_idx, uint32_t bmask);
 
@@ -150,11 +560,264 @@ enum apipc_rc apipc_flags_clear_bits(uint16_t obj_idx, uint32_t bmask);
  * values over core initialization before main process and apipc_app starts
  * being called. 
  *
+ * When APIPC_STARTUP_IMAGE is enabled startup flagged objects are serialized
+ * into one image and transmitted with a single command and response. See
+ * APIPC_STARTUP_IMAGE.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS once every obj was started on the remote
+ * core, APIPC_RC_FAIL while the startup is still in process.
+ *
  * \note remote core should be able to process apipc messages.
  * 
  */
 enum apipc_rc apipc_startup_remote(void);
 
+/**
+ * @brief Open a transaction
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the transaction was opened,
+ * APIPC_RC_BUSY if the last committed one is still being transmitted.
+ *
+ * A transaction serializes several objects into one image, transmitted with a
+ * single APIPC_IMAGE_WRITE command. The remote core copies every object before
+ * running any of their receive hooks and acknowledges the whole transaction
+ * with a single response, so related objects are never seen half updated.
+ * Opening a transaction drops the objects added to a previous uncommitted one.
+ */
+enum apipc_rc apipc_tx_begin(void);
+
+/**
+ * @brief Add an object to the open transaction
+ *
+ * \param[in] obj_idx object index number
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the obj was added, APIPC_RC_FAIL if no
+ * transaction is open, obj_idx is out of range or wasn't registered, the obj
+ * is an APIPC_OBJ_TYPE_FUNC_CALL one, is longer than APIPC_STREAM_CHUNK words
+ * or isn't bound to APIPC_LINK_0.
+ */
+enum apipc_rc apipc_tx_add(uint16_t obj_idx);
+
+/**
+ * @brief Commit the open transaction
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the transaction was committed,
+ * APIPC_RC_BUSY if cl_r_w_data has no space for it now, the transaction is
+ * kept open to be committed again, APIPC_RC_FAIL if no transaction is open, it
+ * has no objects or its image is longer than cl_r_w_data. A failed
+ * transaction is closed.
+ *
+ * Objects values are copied by the call, apipc_app() transmits them. Follow
+ * the transmition with apipc_tx_state(), APIPC_OBJ_SM_IDLE once the remote
+ * core applied it, APIPC_OBJ_SM_FAIL if every retry was lost. Retries put the
+ * committed copy again, it keeps its cl_r_w_data space until then.
+ */
+enum apipc_rc apipc_tx_commit(void);
+
+/**
+ * @brief Consult the state of the last committed transaction
+ *
+ * \return apipc_obj_sm actual state of the transaction sm.
+ */
+enum apipc_obj_sm apipc_tx_state(void);
+
+/**
+ * @brief Register a remote procedure handler
+ *
+ * \param[in] fn_id handler id the remote core will call it by
+ * \param[in] handler function that serves the call
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the handler was registered,
+ * APIPC_RC_FAIL if fn_id is out of range or handler == NULL.
+ *
+ * \note Multiple registrations over the same fn_id will cause overwriting.
+ */
+enum apipc_rc apipc_rpc_register(uint16_t fn_id, apipc_rpc_handler handler);
+
+/**
+ * @brief Call a remote procedure asynchronously
+ *
+ * \param[in] fn_id handler id registered on the remote core
+ * \param[in] args pointer to the arguments struct, could be NULL if args_len
+ * is 0
+ * \param[in] args_len arguments length in words
+ * \param[out] ret pointer where the result will be copied, could be NULL if
+ * ret_max is 0
+ * \param[in] ret_max space available on ret in words
+ *
+ * \return call handle to be consulted with apipc_rpc_status(),
+ * APIPC_RPC_HANDLE_NONE if the call couldn't be started.
+ *
+ * Arguments are marshalled on the local cl_r_w_data, so args could be reused
+ * as soon as the function returns. The remote core runs the handler from his
+ * apipc_app(), writes the result on his own cl_r_w_data and the local core
+ * copies it to ret once it is received.
+ *
+ * \note ret must stay valid until the call completes.
+ */
+uint16_t apipc_rpc_call(uint16_t fn_id, const void *args, uint16_t args_len,
+                        void *ret, uint16_t ret_max);
+
+/**
+ * @brief Consult a remote procedure call completion
+ *
+ * \param[in] handle call handle returned by apipc_rpc_call()
+ * \param[out] pret_len pointer where the result length in words is written
+ * on completion, could be NULL.
+ *
+ * \return apipc_rc APIPC_RC_PENDING while the call is waiting his return,
+ * APIPC_RC_SUCCESS once the result was copied, APIPC_RC_TIMEOUT if the remote
+ * core didn't return on APIPC_RPC_TIMEOUT and APIPC_RC_FAIL if the handle is
+ * unknown or the remote core couldn't serve the call.
+ *
+ * \note The handle is released once a completion other than
+ * APIPC_RC_PENDING is reported.
+ */
+enum apipc_rc apipc_rpc_status(uint16_t handle, uint16_t *pret_len);
+
+/**
+ * @brief Register a mailbox handler
+ *
+ * \param[in] id mailbox id the remote core will send messages to
+ * \param[in] handler function that serves the messages
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the handler was registered,
+ * APIPC_RC_FAIL if id is out of range.
+ *
+ * \note A NULL handler unregisters the id, its messages are then dropped.
+ */
+enum apipc_rc apipc_mbox_register(uint16_t id, apipc_mbox_handler handler);
+
+/**
+ * @brief Send a short message through the mailbox
+ *
+ * \param[in] id remote mailbox handler id
+ * \param[in] data pointer to the message words, could be NULL if len is 0
+ * \param[in] len message length in words, up to APIPC_MBOX_WORDS
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the message was posted,
+ * APIPC_RC_PENDING if the remote core didn't take the previous message yet
+ * and APIPC_RC_FAIL if parameters are out of range.
+ *
+ * The message is dispatched on the remote core from his IPC2 interrupt,
+ * without going through apipc_app(). There is no response nor retry, a
+ * posted message is delivered as soon as the remote interrupt is served.
+ *
+ * \note Function could be called from interrupt context.
+ */
+enum apipc_rc apipc_mbox_send(uint16_t id, const uint16_t *data, uint16_t len);
+
+/**
+ * @brief Process received messages up to a bound
+ *
+ * \param[in] max_msgs maximum number of messages processed by the call
+ *
+ * \return number of messages processed, mailbox messages included.
+ *
+ * Lanes are served round robin, one message each per round, until max_msgs
+ * messages were processed or every lane is empty. When APIPC_POLLED is enabled
+ * messages are read straight from the ipc driver GetBuffers and the remote
+ * mailbox is dispatched from here, otherwise they are taken from the lane
+ * queues the ISR handlers fill. DATA & FLAGS writes are keyed by obj, only
+ * the newest one pending per obj is applied, see APIPC_KEYED_WRITE. Pending
+ * keyed writes are applied before any later message of their lane, so a lane
+ * keeps its order. A keyed write counts against max_msgs once read from the
+ * GetBuffer and once applied, a lane is left for the next call if the keyed
+ * writes pending on its link could take the rest of the bound.
+ *
+ * Worst-case execution time is bounded by max_msgs times the most expensive
+ * received command:
+ * - DATA, keyed, SET_BITS, CLEAR_BITS & FUNC_CALL responses or commands run
+ *   in constant time.
+ * - BLOCK & DELTA writes copy at most APIPC_STREAM_CHUNK words, larger blocks
+ *   are always streamed.
+ * - IMAGE writes copy the startup image or a committed transaction, at most
+ *   CL_R_W_DATA_LENGTH words. They happen on apipc_startup_remote() and on
+ *   every remote apipc_tx_commit(), retries included.
+ * - RPC calls & mailbox messages add the registered handler time.
+ *
+ * \note On APIPC_POLLED builds apipc_poll() replaces the messages processing
+ * apipc_app() does, so it must be called periodically.
+ */
+uint16_t apipc_poll(uint16_t max_msgs);
+
+/**
+ * @brief Copy apipc statistics
+ *
+ * \param[out] pstats pointer where statistics are copied
+ * \param[in] reset clear counters and high-water marks once copied. stage_live
+ * is never cleared.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS, APIPC_RC_FAIL if pstats == NULL.
+ *
+ * \note Goodput is tx_words over the sampling interval. Once traffic stops and
+ * every obj went back to idle, stage_live should be back to 0.
+ */
+enum apipc_rc apipc_stats(struct apipc_stats *pstats, uint16_t reset);
+
+/**
+ * @brief Put a latency probe on a link lane
+ *
+ * \param[in] link link of the peer to probe
+ * \param[in] lane lane the probe travels on, APIPC_LANE_AUTO picks the least
+ * loaded one.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if the probe was put, APIPC_RC_BUSY if the
+ * last probe still waits his echo or the lane has no credits, APIPC_RC_FAIL if
+ * link or lane are out of range, the link wasn't registered, apipc isn't
+ * inited or the put failed.
+ *
+ * The probe is stamped with ipc_read_timer() when it is put, when the remote
+ * ISR gets it, when the remote apipc_app() echoes it and when the local ISR
+ * gets the echo. Both cores read the same IPCCOUNTER, so every leg is measured
+ * on its own, see enum apipc_probe_leg. On APIPC_POLLED builds the ISR stamps
+ * are taken by apipc_poll() when the message is read from the ipc driver.
+ */
+enum apipc_rc apipc_probe_send(uint16_t link, enum apipc_lane_id lane);
+
+/**
+ * @brief Probe a link lane periodically
+ *
+ * \param[in] link link of the peer to probe
+ * \param[in] lane lane the probes travel on
+ * \param[in] period ipc free-running counter ticks between probes, 0 stops the
+ * monitor. See IPC_TIMER_WAIT_xxxmS.
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS, APIPC_RC_FAIL if link or lane are out of
+ * range or the link wasn't registered.
+ *
+ * apipc_app() puts a probe once the period elapsed and the last one was echoed
+ * or lost. Keep the period long against the latencies measured, the monitor is
+ * meant to run on the field at a low rate.
+ */
+enum apipc_rc apipc_probe_monitor(uint16_t link, enum apipc_lane_id lane,
+                                  uint64_t period);
+
+/**
+ * @brief Copy a link latency probe statistics
+ *
+ * \param[in] link link to consult
+ * \param[out] pstats pointer where statistics are copied
+ * \param[in] reset clear the statistics once copied
+ *
+ * \return apipc_rc APIPC_RC_SUCCESS if statistics were copied, APIPC_RC_FAIL if
+ * link is out of range, the link wasn't registered or pstats == NULL.
+ */
+enum apipc_rc apipc_probe_stats(uint16_t link, struct apipc_probe_stats *pstats,
+                                uint16_t reset);
+
+#if APIPC_FAULT_INJECT
+/**
+ * @brief Register the received messages fault injection hook
+ *
+ * \param[in] handler hook deciding the fault applied to every received
+ * message, NULL stops injecting faults.
+ *
+ * \note Only available on APIPC_FAULT_INJECT builds, never on production ones.
+ */
+void apipc_fault_register(apipc_fault_handler handler);
+#endif
+
 /**
  * @brief apipc application
  *
@@ -163,9 +826,30 @@ enum apipc_rc apipc_startup_remote(void);
  */
 void apipc_app(void);
 
+/**
+ * @brief apipc application with a time budget
+ *
+ * \param[in] ticks ipc free-running counter ticks the call could take. See
+ * IPC_TIMER_WAIT_xxxmS. 0 runs unbounded, as apipc_app() does.
+ *
+ * Does the same job apipc_app() does but stops as soon as the budget, measured
+ * with ipc_read_timer(), is used up. The next call resumes from the following
+ * object. Block staging copies are split on APIPC_STAGE_CHUNK words steps and
+ * stream windows are refilled one fragment at least, so a large block spreads
+ * over several calls and the background loop gets a predictable apipc slice.
+ *
+ * \note The budget is checked between steps, a call could overrun it by one
+ * object step, one APIPC_STAGE_CHUNK copy or one stream fragment. A block
+ * modified while its staging copy was split is copied again whole once the
+ * copy completes, so it never reaches the remote core mixing old and new
+ * words, and that call overruns the budget by one block copy.
+ */
+void apipc_app_budgeted(uint64_t ticks);
+
 /* IPC interrupt Handlers Functions declarations */
 interrupt void apipc_ipc0_isr_handler(void); /**< IPC0 interrupt Handler */
 interrupt void apipc_ipc1_isr_handler(void); /**< IPC1 interrupt Handler */
+interrupt void apipc_ipc2_isr_handler(void); /**< IPC2 mailbox interrupt Handler */
 
 #endif
 
@@ -114,8 +114,40 @@
 /** CPU0n_TO_CPU0n_R_W_DATA space length*/
 #define CL_R_W_DATA_LENGTH 4096
 
-/** Maximum number of object apipc allocates and can handle */
+/** Maximum number of object apipc allocates and can handle, on every link
+ * together */
+#ifndef APIPC_MAX_OBJ
 #define APIPC_MAX_OBJ 10
+#endif
+
+/** Number of IPC driver controllers apipc uses as independent lanes */
+#define APIPC_MAX_LANE 2
+
+/**
+ * Number of peers apipc can link to. F2837xD cores only reach each other
+ * through APIPC_LINK_0, parts with more endpoints, or simulated nodes, raise
+ * it and register the extra links. See apipc_link_register().
+ */
+#ifndef APIPC_MAX_LINK
+#define APIPC_MAX_LINK 1
+#endif
+
+/** CPU1 - CPU2 link id */
+#define APIPC_LINK_0 0
+
+/**
+ * Maximum number of commands a lane can keep waiting for a remote response.
+ * Objects that find their lane budget exhausted wait on APIPC_OBJ_SM_WRITING
+ * until a response releases a slot. Every command waiting a response takes a
+ * slot, stream fragments, images, remote procedure calls, probes and
+ * apipc_send_isr() puts included.
+ *
+ * Responses land on the remote core queue credits kept for them, so the
+ * budget can't be larger than APIPC_CREDIT_RESERVE.
+ */
+#ifndef APIPC_LANE_BUDGET
+#define APIPC_LANE_BUDGET APIPC_CREDIT_RESERVE
+#endif
 
 /**
  * The following values extends the IPC driver command values passed between
@@ -127,6 +159,354 @@
  */
 #define APIPC_MESSAGE 0x0001000C 
 
+/**
+ * apipc image write command. An image serializes several objects into one
+ * contiguous cl_r_w_data space. The remote core applies every object in one
+ * pass and acknowledges the whole image with a single response.
+ *
+ * tIpcMessage.uladdress holds the image address, uldataw1 the image length in
+ * words and uldataw2 the number of objects serialized on it.
+ */
+#define APIPC_IMAGE_WRITE 0x0001000D
+
+/**
+ * apipc remote procedure call commands.
+ *
+ * APIPC_RPC_CALL requests the remote core to run a registered handler.
+ * tIpcMessage.uladdress holds the arguments address on the caller cl_r_w_data,
+ * uldataw1 the handler id on the upper half and the arguments length in words on
+ * the lower one, and uldataw2 the space reserved for the result in words on the
+ * upper half and the call tag on the lower one.
+ *
+ * APIPC_RPC_RETURN carries the result back. uladdress holds the result address
+ * on the remote cl_r_w_data, uldataw1 the call apipc_rc on the upper half and
+ * the result length in words on the lower one, and uldataw2 the call tag. Its
+ * response releases the result and echoes the call tag on uldataw2, a repeated
+ * one frees nothing once the space holds a newer result.
+ */
+#define APIPC_RPC_CALL 0x0001000E
+#define APIPC_RPC_RETURN 0x0001000F
+
+/**
+ * apipc delta write command. Only the word runs of a block that changed since
+ * the last transmition are packed on cl_r_w_data as a sequence of
+ * [offset, len, data[len]] words and patched in place by the remote core.
+ *
+ * tIpcMessage.uladdress holds the remote block address, uldataw1 the packed
+ * runs address and uldataw2 the packed length in words.
+ */
+#define APIPC_DELTA_WRITE 0x00010010
+
+/**
+ * apipc checked block write command. The block is staged on cl_r_w_data
+ * followed by his CRC32, low word first, and the remote core only commits it
+ * once the CRC32 matches. See apipc_obj_set_crc().
+ *
+ * tIpcMessage.uladdress holds the remote block address, uldataw1 the staging
+ * address and uldataw2 the block length in words. The response echoes the
+ * apipc_rc of the check on uldataw2.
+ */
+#define APIPC_CRC_WRITE 0x00010011
+
+/**
+ * apipc keyed write command. DATA & FLAGS objs values travel on it so the
+ * remote core keeps only the newest write pending per obj and skips the
+ * superseded ones.
+ *
+ * tIpcMessage.uladdress holds the remote obj address, uldataw1 the write
+ * generation, the obj index & the IPC_LENGTH_xx_BITS length packed by
+ * APIPC_KEYED_W1() and uldataw2 the value. The response echoes the applied
+ * generation on uldataw2, it acknowledges the superseded writes too.
+ */
+#define APIPC_KEYED_WRITE 0x00010012
+
+/** keyed write uldataw1 packing & unpacking */
+#define APIPC_KEYED_W1(gen, obj_idx, len) \
+    (((uint32_t)(gen) << 16) | ((uint32_t)(obj_idx) << 2) | (uint32_t)(len))
+#define APIPC_KEYED_GEN(w1) ((uint16_t)((w1) >> 16))
+#define APIPC_KEYED_OBJ(w1) ((uint16_t)((uint16_t)(w1) >> 2))
+#define APIPC_KEYED_LEN(w1) ((uint16_t)(w1) & 0x0003)
+
+/**
+ * apipc latency probe commands, see apipc_probe_send(). Stamps are the low 32
+ * bits of ipc_read_timer(), the IPCCOUNTER both cores read.
+ *
+ * APIPC_PROBE tIpcMessage.uladdress holds the probe sequence number, uldataw1
+ * the sender put stamp and uldataw2 the remote ISR stamp, written on arrival.
+ * APIPC_PROBE_ECHO uladdress echoes the sequence number, uldataw1 the remote
+ * ISR stamp and uldataw2 the remote apipc_app() stamp.
+ */
+#define APIPC_PROBE 0x00010013
+#define APIPC_PROBE_ECHO 0x00010014
+
+/**
+ * apipc inline write command. APIPC_OBJ_TYPE_INLINE objs are packed on the
+ * message words, first word on the low half of uldataw1, and unpacked straight
+ * on the remote obj, with no cl_r_w_data staging.
+ *
+ * tIpcMessage.uladdress holds the remote obj address, uldataw1 words 0 & 1 and
+ * uldataw2 words 2 & 3. The remote core copies as many words as his obj length.
+ */
+#define APIPC_INLINE_WRITE 0x00010015
+
+/** APIPC_OBJ_TYPE_INLINE objs maximum length in words */
+#define APIPC_INLINE_WORDS 4
+
+/**
+ * apipc lease commands, see apipc_obj_set_lease().
+ *
+ * APIPC_LEASE_WRITE is laid out as IPC_BLOCK_WRITE, but uldataw1 packs the obj
+ * lease generation instead of the word size, see APIPC_LEASE_W1(), and the
+ * remote core keeps the staging space instead of copying it. A retransmition
+ * puts the same staging space & generation again, only newer generations
+ * land, and the response echoes the generation on uldataw2. APIPC_LEASE_RELEASE
+ * gives it back, tIpcMessage.uladdress holds the released staging address and
+ * uldataw1 his generation, and is put again until its response, that echoes
+ * both.
+ */
+#define APIPC_LEASE_WRITE 0x00010016
+#define APIPC_LEASE_RELEASE 0x00010017
+
+/** lease write uldataw1 packing & unpacking, 16-bit words only */
+#define APIPC_LEASE_W1(gen, len) (((uint32_t)(gen) << 16) | (uint32_t)(len))
+#define APIPC_LEASE_GEN(w1) ((uint16_t)((w1) >> 16))
+#define APIPC_LEASE_LEN(w1) ((uint16_t)(w1))
+
+/** staging spaces a link could have lent to his peer at once */
+#ifndef APIPC_LEASE_MAX
+#define APIPC_LEASE_MAX 4
+#endif
+
+/** staging spaces a link could be giving back at once. The peer frees a space
+ * on the first release it gets and may lend it again, or lend another one,
+ * while that release still waits its response */
+#define APIPC_LEASE_RET (2 * APIPC_LEASE_MAX)
+
+/**
+ * Unchanged words a delta run swallows before being closed. Each run costs two
+ * header words so short gaps are cheaper transmitted than split.
+ */
+#define APIPC_DELTA_MERGE_GAP 2
+
+/**
+ * Packed length, in words, over which a delta write of a len words block is
+ * considered dense and the whole block is transmitted instead.
+ */
+#define APIPC_DELTA_DENSE(len) ((len) - ((len) >> 2))
+
+/**
+ * \brief apipc block streaming
+ *
+ * APIPC_OBJ_TYPE_BLOCK objects larger than APIPC_STREAM_CHUNK words aren't
+ * copied to cl_r_w_data at once. They are streamed as APIPC_STREAM_CHUNK words
+ * fragments, keeping up to APIPC_STREAM_WINDOW of them in flight, and written
+ * in place on the remote block. The obj transmition completes once every
+ * fragment was acknowledged.
+ *
+ * APIPC_MAX_STREAM objects could be streamed at the same time, the others wait
+ * on APIPC_OBJ_SM_WRITING until a stream is released.
+ * @{ */
+#ifndef APIPC_STREAM_CHUNK
+#define APIPC_STREAM_CHUNK 512
+#endif
+
+#ifndef APIPC_STREAM_WINDOW
+#define APIPC_STREAM_WINDOW IPC_BUFFER_SIZE
+#endif
+
+#ifndef APIPC_MAX_STREAM
+#define APIPC_MAX_STREAM 1
+#endif
+/**@}*/
+
+/** Maximum number of remote procedure calls waiting to be returned */
+#ifndef APIPC_RPC_MAX_CALLS
+#define APIPC_RPC_MAX_CALLS 4
+#endif
+
+/** Maximum number of remote procedure handlers a core could register */
+#ifndef APIPC_RPC_MAX_FUNC
+#define APIPC_RPC_MAX_FUNC 8
+#endif
+
+/** ipc free-running counter ticks a remote procedure call waits its return */
+#ifndef APIPC_RPC_TIMEOUT
+#define APIPC_RPC_TIMEOUT IPC_TIMER_WAIT_100mS
+#endif
+
+/** apipc_rpc_call() returned handle when the call couldn't be started */
+#define APIPC_RPC_HANDLE_NONE 0xFFFF
+
+/**
+ * \brief apipc mailbox
+ *
+ * Event notifications and short commands of up to APIPC_MBOX_WORDS words skip
+ * the ipc driver put/get buffers and lane queues. The sender writes them on a
+ * mailbox reserved on the top of his MSGRAM and raises APIPC_FLAG_IRQ_MBOX.
+ * The remote core runs the handler registered for the mailbox id straight
+ * from apipc_ipc2_isr_handler(), or from apipc_poll() on APIPC_POLLED builds,
+ * and acknowledges the flag, which frees the mailbox for the next message.
+ *
+ * \note The last APIPC_MBOX_SIZE words of CPU1TOCPU2RAM & CPU2TOCPU1RAM must be
+ * kept out of any linker section.
+ * @{ */
+#define APIPC_MBOX_WORDS 4 /**< mailbox message maximum length in words */
+#define APIPC_MBOX_SIZE 0x0008 /**< MSGRAM words reserved for a mailbox */
+
+/** CPU01 to CPU02 mailbox address, top of CPU1TOCPU2RAM */
+#define APIPC_CPU01_TO_CPU02_MBOX (uint32_t)0x0003FFF8
+
+/** CPU02 to CPU01 mailbox address, top of CPU2TOCPU1RAM */
+#define APIPC_CPU02_TO_CPU01_MBOX (uint32_t)0x0003FBF8
+
+/** Maximum number of mailbox handlers a core could register */
+#ifndef APIPC_MBOX_MAX_ID
+#define APIPC_MBOX_MAX_ID 8
+#endif
+/**@}*/
+
+/**
+ * \brief apipc credit flow control
+ *
+ * Every core publishes how many messages it took off each lane queue, drops
+ * included, on a credits block under his mailbox. The sender compares it with
+ * the messages it put on the lane to know the free remote queue slots, its
+ * credits. Commands are held once APIPC_CREDIT_RESERVE credits are left, those
+ * are kept for responses. Held objs wait queued on APIPC_OBJ_SM_WRITING
+ * instead of being lost on a full queue and retried on timeout, and
+ * apipc_send() reports APIPC_RC_BUSY meanwhile.
+ *
+ * A core never has more than APIPC_LANE_BUDGET commands waiting a response on
+ * a lane, so the responses the remote core owes always fit on the credits
+ * kept for them.
+ *
+ * \note The APIPC_CREDIT_SIZE words under each mailbox must be kept out of any
+ * linker section too.
+ * @{ */
+#ifndef APIPC_CREDIT_RESERVE
+#define APIPC_CREDIT_RESERVE (APIPC_MAX_OBJ / 2)
+#endif
+
+#if APIPC_LANE_BUDGET > APIPC_CREDIT_RESERVE || APIPC_CREDIT_RESERVE >= APIPC_MAX_OBJ
+#error "APIPC_LANE_BUDGET should fit on APIPC_CREDIT_RESERVE, below APIPC_MAX_OBJ"
+#endif
+
+#define APIPC_CREDIT_SIZE 0x0004 /**< MSGRAM words reserved for the credits */
+
+/** CPU01 to CPU02 credits address, under CPU01 to CPU02 mailbox */
+#define APIPC_CPU01_TO_CPU02_CREDIT (APIPC_CPU01_TO_CPU02_MBOX - APIPC_CREDIT_SIZE)
+
+/** CPU02 to CPU01 credits address, under CPU02 to CPU01 mailbox */
+#define APIPC_CPU02_TO_CPU01_CREDIT (APIPC_CPU02_TO_CPU01_MBOX - APIPC_CREDIT_SIZE)
+/**@}*/
+
+/**
+ * \brief apipc polled mode
+ *
+ * When APIPC_POLLED is defined to 1 apipc doesn't enable the IPC0, IPC1 & IPC2
+ * PIE interrupts and the ISR handlers shouldn't be mapped. Received messages
+ * and mailbox messages are read straight from the ipc driver GetBuffers by
+ * apipc_poll(), which the application calls at a fixed point of its schedule.
+ */
+#ifndef APIPC_POLLED
+#define APIPC_POLLED 0
+#endif
+
+/**
+ * Words a block staging copy moves between budget checks on
+ * apipc_app_budgeted() calls. See apipc_app_budgeted().
+ */
+#ifndef APIPC_STAGE_CHUNK
+#define APIPC_STAGE_CHUNK 64
+#endif
+
+/**
+ * \brief apipc fault injection
+ *
+ * When APIPC_FAULT_INJECT is defined to 1 every received message, commands and
+ * responses alike, goes through the hook registered with apipc_fault_register()
+ * before being processed. The hook could drop, duplicate or delay it, which
+ * lets a soak run prove retries & timeouts keep the throughput under loss.
+ *
+ * A delayed message is held APIPC_FAULT_DELAY_TICKS ticks while the
+ * following ones are processed, so it also gets reordered. A lane holds one delayed
+ * message at a time, further delays are processed right away.
+ * @{ */
+#ifndef APIPC_FAULT_INJECT
+#define APIPC_FAULT_INJECT 0
+#endif
+
+#ifndef APIPC_FAULT_DELAY_TICKS
+#define APIPC_FAULT_DELAY_TICKS IPC_TIMER_WAIT_2mS
+#endif
+/**@}*/
+
+/**
+ * \brief apipc bulk startup image
+ *
+ * When APIPC_STARTUP_IMAGE is defined to 1, apipc_startup_remote() serializes
+ * every startup flagged object, but APIPC_OBJ_TYPE_FUNC_CALL ones, into one
+ * image and transmits it with a single command instead of one command and one
+ * response per object. If the image can't be allocated or the remote core
+ * doesn't respond, objects fall back to the per object startup.
+ */
+#ifndef APIPC_STARTUP_IMAGE
+#define APIPC_STARTUP_IMAGE 0
+#endif
+
+/**
+ * \brief apipc interrupt coalescing
+ *
+ * Messages are put on a lane without raising the remote IPC interrupt until
+ * APIPC_COALESCE_MSGS of them are pending, the driver PutBuffer gets full or
+ * the oldest one waited APIPC_COALESCE_TICKS, checked by apipc_app(). The
+ * remote ISR drains all of them on a single interrupt.
+ *
+ * Urgent objs, see apipc_obj_set_urgent(), and remote procedure calls raise it
+ * right away. Responses raise it once the pass over the received messages that
+ * put them is over. By default it is raised once the PutBuffer is full,
+ * APIPC_COALESCE_MSGS 1 raises it on every put.
+ * @{ */
+#ifndef APIPC_COALESCE_MSGS
+#define APIPC_COALESCE_MSGS (IPC_BUFFER_SIZE - 1)
+#endif
+
+#ifndef APIPC_COALESCE_TICKS
+#define APIPC_COALESCE_TICKS (IPC_TIMER_WAIT_1mS / 20) /**< 50uS */
+#endif
+/**@}*/
+
+/**
+ * \brief apipc latency probe
+ *
+ * Latency distributions keep APIPC_PROBE_BUCKETS log2 buckets, bucket n counts
+ * latencies from 2^n up to 2^(n+1) - 1 ticks, bucket 0 the 0 & 1 tick ones and
+ * the last bucket every longer one. A probe whose echo didn't arrive after
+ * APIPC_PROBE_TIMEOUT ticks is counted lost.
+ * @{ */
+#ifndef APIPC_PROBE_BUCKETS
+#define APIPC_PROBE_BUCKETS 20 /**< up to 5mS at 200MHz */
+#endif
+
+#ifndef APIPC_PROBE_TIMEOUT
+#define APIPC_PROBE_TIMEOUT IPC_TIMER_WAIT_100mS
+#endif
+/**@}*/
+
+/**
+ * \brief apipc initialization state machine's states definition
+ *
+ * apipc_init_step() evolves through them while the local core waits the remote
+ * one.
+ */
+enum apipc_init_sm
+{
+    APIPC_INIT_SM_UNKNOWN = 0, /**< apipc_init_start() wasn't called yet */
+    APIPC_INIT_SM_SRAM_ACCES, /**< waiting GSxM blocks to be granted */
+    APIPC_INIT_SM_REMOTE_INIT, /**< waiting remote core apipc to be inited */
+    APIPC_INIT_SM_DONE /**< apipc is inited on both cores */
+};
+
 /**
  * \brief apipc app state machine's states definition
  */
@@ -180,6 +560,15 @@ enum apipc_msg_cmd
     APIPC_MSG_CMD_CLEAR_BITS_PROTECTED_RSP  = 0x00010009,
     APIPC_MSG_CMD_DATA_WRITE_PROTECTED_RSP  = 0x0001000A,
     APIPC_MSG_CMD_BLOCK_WRITE_PROTECTED_RSP = 0x0001000B,
+
+    APIPC_MSG_CMD_IMAGE_WRITE_RSP           = APIPC_IMAGE_WRITE,
+    APIPC_MSG_CMD_RPC_RETURN_RSP            = APIPC_RPC_RETURN,
+    APIPC_MSG_CMD_DELTA_WRITE_RSP           = APIPC_DELTA_WRITE,
+    APIPC_MSG_CMD_CRC_WRITE_RSP             = APIPC_CRC_WRITE,
+    APIPC_MSG_CMD_KEYED_WRITE_RSP           = APIPC_KEYED_WRITE,
+    APIPC_MSG_CMD_INLINE_WRITE_RSP          = APIPC_INLINE_WRITE,
+    APIPC_MSG_CMD_LEASE_WRITE_RSP           = APIPC_LEASE_WRITE,
+    APIPC_MSG_CMD_LEASE_RELEASE_RSP         = APIPC_LEASE_RELEASE,
 };
 
 /**
@@ -187,8 +576,11 @@ enum apipc_msg_cmd
  */
 enum apipc_rc
 {
+    APIPC_RC_TIMEOUT = -2, /**< TIMEOUT! process didn't end on time */
     APIPC_RC_FAIL = -1, /**<  FAIL! */
-    APIPC_RC_SUCCESS = 0 /**< SUCCESS! */
+    APIPC_RC_SUCCESS = 0, /**< SUCCESS! */
+    APIPC_RC_PENDING = 1, /**< process is still ongoing, call again */
+    APIPC_RC_BUSY = 2 /**< remote core is back-pressuring, slow down */
 };
 
 /**
@@ -206,6 +598,7 @@ enum apipc_flags
 {
     APIPC_FLAG_IRQ_IPC0 = IPC_FLAG0, /**< g_sIpcController1 interrupt flag */
     APIPC_FLAG_IRQ_IPC1 = IPC_FLAG1, /**< g_sIpcController2 interrupt flag */
+    APIPC_FLAG_IRQ_MBOX = IPC_FLAG2, /**< mailbox message interrupt flag */
 
     APIPC_FLAG_API_INITED = IPC_FLAG4, /**< Local apipc implementation inited */
     APIPC_FLAG_SRAM_ACCES = IPC_FLAG5, /**< Local (CPU1) granted GSMEM acces to
@@ -223,6 +616,191 @@ enum apipc_obj_type
     APIPC_OBJ_TYPE_DATA    = 2, /**< obj will be treated as an unique value */ 
     APIPC_OBJ_TYPE_FLAGS   = 3, /**< obj will be treated as flags */
     APIPC_OBJ_TYPE_FUNC_CALL = 4, /** obj will be treated as a funcion */
+    APIPC_OBJ_TYPE_SNAPSHOT = 5, /**< obj will be treated as a block landing on
+                                   a triple buffered snapshot */
+    APIPC_OBJ_TYPE_INLINE = 6, /**< obj of up to APIPC_INLINE_WORDS words
+                                 carried on the message words, no staging */
+};
+
+/**
+ * \brief apipc transport lanes definition
+ *
+ * Every IPC driver controller is handled as an independent lane with its own
+ * received messages queue, commands budget and statistics. Objects could be
+ * pinned to a lane, i.e. to keep latency sensitive objects apart from bulk
+ * ones, or let apipc spread them by load.
+ */
+enum apipc_lane_id
+{
+    APIPC_LANE_0 = 0, /**< g_sIpcController1 lane, served on IPC_INT0 */
+    APIPC_LANE_1 = 1, /**< g_sIpcController2 lane, served on IPC_INT1 */
+    APIPC_LANE_AUTO = 2, /**< obj is transmitted on the least loaded lane */
+};
+
+/**
+ * \brief apipc lane statistics definition
+ */
+struct apipc_lane_stats
+{
+    uint32_t tx_cmd; /**< commands put on the lane */
+    uint32_t tx_rsp; /**< responses put on the lane */
+    uint32_t tx_fail; /**< ipc driver puts that failed */
+    uint32_t rx_msg; /**< messages received on the lane */
+    uint32_t rx_drop; /**< received messages lost, queue was full */
+    uint32_t timeout; /**< commands that never got a remote response */
+    uint16_t inflight_max; /**< commands waiting response high-water mark */
+    uint32_t irq_raised; /**< remote interrupts raised, see APIPC_COALESCE_MSGS */
+    uint32_t tx_held; /**< command puts held, the remote queue had no credits */
+    uint32_t rx_superseded; /**< keyed writes skipped, a newer one was pending */
+};
+
+/**
+ * \brief apipc latency probe legs definition
+ */
+enum apipc_probe_leg
+{
+    APIPC_PROBE_LEG_ISR = 0, /**< local put to remote ISR, one-way */
+    APIPC_PROBE_LEG_QUEUE, /**< remote ISR to remote apipc_app() */
+    APIPC_PROBE_LEG_ECHO, /**< remote apipc_app() to local ISR, one-way */
+    APIPC_PROBE_LEG_RTT, /**< local put to local ISR, round trip */
+    APIPC_PROBE_LEGS
+};
+
+/**
+ * \brief apipc latency distribution definition, in ipc_read_timer() ticks
+ */
+struct apipc_probe_dist
+{
+    uint32_t min; /**< shortest latency, 0xFFFFFFFF until the first sample */
+    uint32_t max; /**< longest latency */
+    uint32_t last; /**< last latency */
+    uint64_t sum; /**< latencies sum, the mean is sum over apipc_probe_stats.done */
+    uint32_t hist[APIPC_PROBE_BUCKETS]; /**< log2 histogram, see
+                                          APIPC_PROBE_BUCKETS */
+};
+
+/**
+ * \brief apipc latency probe statistics definition
+ *
+ * See apipc_probe_stats().
+ */
+struct apipc_probe_stats
+{
+    uint32_t sent; /**< probes put */
+    uint32_t done; /**< probes echoed back */
+    uint32_t lost; /**< probes without echo after APIPC_PROBE_TIMEOUT */
+    struct apipc_probe_dist leg[APIPC_PROBE_LEGS]; /**< latency per leg */
+};
+
+/**
+ * \brief apipc statistics definition
+ *
+ * Counters a soak run reads to measure the sustained goodput, the recovery
+ * time after losses and that cl_r_w_data staging spaces return to baseline.
+ * See apipc_stats().
+ */
+struct apipc_stats
+{
+    uint32_t tx_done; /**< obj transmitions acknowledged by the remote core */
+    uint32_t tx_words; /**< obj words carried by acknowledged transmitions */
+    uint32_t retry; /**< obj transmitions retried */
+    uint32_t fail; /**< obj transmitions given up after every retry */
+    uint64_t recovery_max; /**< longest ticks from an obj first retry to his
+                             next acknowledged transmition */
+    uint32_t stage_fail; /**< cl_r_w_data staging allocations that failed */
+    uint32_t crc_fail; /**< received blocks rejected on a CRC32 mismatch */
+    uint16_t stage_live; /**< cl_r_w_data staging spaces allocated now */
+    uint16_t stage_max; /**< stage_live high-water mark */
+    uint32_t fault_drop; /**< received messages dropped by the fault hook */
+    uint32_t fault_dup; /**< received messages duplicated by the fault hook */
+    uint32_t fault_delay; /**< received messages delayed by the fault hook */
+    uint32_t isr_push; /**< obj transmitions put by apipc_send_isr() */
+    uint32_t tx_now; /**< obj transmitions written by apipc_send_now() */
+    uint32_t stage_restart; /**< split staging copies started again, their
+                              block changed meanwhile */
+};
+
+/**
+ * \brief apipc injected faults definition
+ */
+enum apipc_fault
+{
+    APIPC_FAULT_NONE = 0, /**< message is processed normally */
+    APIPC_FAULT_DROP, /**< message is lost */
+    APIPC_FAULT_DUP, /**< message is processed twice */
+    APIPC_FAULT_DELAY /**< message is held APIPC_FAULT_DELAY_TICKS ticks */
+};
+
+/**
+ * \brief apipc fault injection hook definition
+ *
+ * \param[in] lane lane the message was received on
+ * \param[in] psMessage received message, read only
+ *
+ * \return apipc_fault to be applied on the message.
+ */
+typedef enum apipc_fault (*apipc_fault_handler)(enum apipc_lane_id lane,
+                                                const tIpcMessage *psMessage);
+
+/**
+ * \brief apipc remote procedure handler definition
+ *
+ * \param[in] args pointer to the marshalled arguments, read only
+ * \param[in] args_len arguments length in words
+ * \param[out] ret pointer where the result should be written
+ * \param[in] ret_max space available on ret in words
+ *
+ * \return result length in words written on ret, never more than ret_max.
+ *
+ * Handlers are registered on the core that serves the call with
+ * apipc_rpc_register() and are executed from apipc_app().
+ */
+typedef uint16_t (*apipc_rpc_handler)(const uint16_t *args, uint16_t args_len,
+                                      uint16_t *ret, uint16_t ret_max);
+
+/**
+ * \brief apipc mailbox handler definition
+ *
+ * \param[in] data pointer to the message words, read only. Valid only while
+ * the handler runs.
+ * \param[in] len message length in words
+ *
+ * Handlers are registered with apipc_mbox_register() and run in the IPC2
+ * interrupt context, so they should be kept short.
+ */
+typedef void (*apipc_mbox_handler)(const uint16_t *data, uint16_t len);
+
+/**
+ * \brief apipc receive hook definition
+ *
+ * \param[in] obj_idx index of the obj the remote core wrote
+ * \param[in] timestamp ipc free-running counter value once the local copy
+ * completed
+ *
+ * Hooks are registered on the receiving core with apipc_obj_set_rx_hook() and
+ * run wherever received messages are processed: apipc_app() or apipc_poll().
+ */
+typedef void (*apipc_rx_hook)(uint16_t obj_idx, uint64_t timestamp);
+
+/**
+ * \brief apipc mailbox layout definition
+ */
+struct apipc_mbox
+{
+    uint16_t id; /**< handler id the message is dispatched to */
+    uint16_t len; /**< message length in words */
+    uint16_t data[APIPC_MBOX_WORDS]; /**< message words */
+};
+
+/**
+ * \brief apipc credits definition
+ *
+ * Published by the receiving core, see APIPC_CREDIT_RESERVE.
+ */
+struct apipc_credit
+{
+    uint16_t rx_done[APIPC_MAX_LANE]; /**< messages taken off each lane queue,
+                                        wraps */
 };
 
 /**
@@ -232,25 +810,90 @@ struct apipc_obj_flag
 {
     uint16_t startup:1; /**< transmit obj on apipc app start up */
     uint16_t error:1; /**< obj transmition failed retry times */
-    uint16_t spare:14; /** not defined - available */
+    uint16_t inflight:1; /**< obj holds a slot of its tx_lane budget */
+    uint16_t image:1; /**< obj is being transmitted serialized on an image */
+    uint16_t delta:1; /**< block obj transmits only changed word runs */
+    uint16_t shadow:1; /**< pshadow holds the last transmitted block image */
+    uint16_t stream:1; /**< obj owns a stream, see APIPC_STREAM_CHUNK */
+    uint16_t crc:1; /**< block obj is transmitted with his CRC32 */
+    uint16_t urgent:1; /**< obj puts aren't coalesced */
+    uint16_t txn:1; /**< obj belongs to the open or committed transaction */
+    uint16_t isr_push:1; /**< apipc_send_isr() puts the obj straight away */
+    uint16_t spare:5; /** not defined - available */
 };
 
 /**
  * \brief apipc object obj definition
+ *
+ * apipc obj is the descriptor shared with the remote core through GSxM RAM.
+ * It only holds what the remote core reads, with a fixed layout, so local
+ * state machine updates never go through arbitrated GSxM RAM. Local control
+ * state lives on apipc_obj_ctl.
  */
 struct apipc_obj
 {
-    uint16_t idx; /**< obj index position on l_apipc_obj array */
-    enum apipc_obj_type type; /** obj type */
-    enum apipc_obj_sm obj_sm; /** actual obj sm state */
     void *paddr; /**< pointer to the obj's local address */
-    uint32_t payload; /**< spare data. TODO: implement */
-    size_t len; /**< obj length in bytes */
-    uint16_t *pGSxM; /**< pointer to the dynamycally allocated memory space on
-                       cl_r_w_data */
-    uint64_t timer; /**< start timer value */
-    uint16_t retry; /**< retrys counts */
-    struct apipc_obj_flag flag; /**< obj flags */
+    uint32_t len; /**< obj length in words */
+    uint16_t type; /**< obj type, see apipc_obj_type */
+    uint16_t flags; /**< descriptor flags, see APIPC_OBJ_LEASE */
+};
+
+/** receiving core consumes the obj block writes in place */
+#define APIPC_OBJ_LEASE 0x0001
+
+/**
+ * \brief apipc objects local control definition
+ *
+ * Local control state of every obj, laid out as a struct of arrays indexed by
+ * obj index. It is never read by the remote core and should be placed on the
+ * core dedicated LSx RAM, see .apipc_ctl section.
+ */
+struct apipc_obj_ctl
+{
+    enum apipc_obj_sm obj_sm[APIPC_MAX_OBJ]; /**< actual obj sm state */
+    struct apipc_obj_flag flag[APIPC_MAX_OBJ]; /**< obj flags */
+    uint16_t retry[APIPC_MAX_OBJ]; /**< retrys counts */
+    enum apipc_lane_id lane[APIPC_MAX_OBJ]; /**< lane the obj is assigned to */
+    enum apipc_lane_id tx_lane[APIPC_MAX_OBJ]; /**< lane the last transmition
+                                                 was put on */
+    uint64_t timer[APIPC_MAX_OBJ]; /**< start timer value */
+    uint16_t *pGSxM[APIPC_MAX_OBJ]; /**< pointer to the dynamycally allocated
+                                      memory space on cl_r_w_data */
+    uint16_t *pshadow[APIPC_MAX_OBJ]; /**< last transmitted block image, on
+                                        delta mode */
+    uint32_t payload[APIPC_MAX_OBJ]; /**< spare data. TODO: implement */
+    uint16_t staged[APIPC_MAX_OBJ]; /**< block words already copied on pGSxM */
+    uint64_t recover[APIPC_MAX_OBJ]; /**< first retry timer value, 0 while the
+                                       obj transmits without losses */
+    apipc_rx_hook rx_hook[APIPC_MAX_OBJ]; /**< hook run when remote data lands */
+    uint32_t crc[APIPC_MAX_OBJ]; /**< running CRC32 of the staged words */
+    uint16_t *pdst[APIPC_MAX_OBJ]; /**< remote address the last transmition
+                                     was put to */
+    uint16_t *psnap[APIPC_MAX_OBJ]; /**< snapshot buffers, NULL if the obj
+                                      isn't a receiving snapshot */
+    volatile uint16_t snap[APIPC_MAX_OBJ]; /**< snapshot buffers indexes, see
+                                             APIPC_SNAP_xxx */
+    uint16_t link[APIPC_MAX_OBJ]; /**< link of the peer the obj is transmitted
+                                    to */
+    uint16_t gen[APIPC_MAX_OBJ]; /**< generation of the last keyed or lease
+                                   write */
+    uint16_t bits[APIPC_MAX_OBJ]; /**< set & clear bits commands waiting their
+                                    response */
+    uint64_t bits_timer[APIPC_MAX_OBJ]; /**< timer value the last set or clear
+                                          bits command was put */
+    uint16_t *pfresh[APIPC_MAX_OBJ]; /**< newest leased staging, not acquired
+                                       yet */
+    uint16_t *pheld[APIPC_MAX_OBJ]; /**< leased staging the application holds */
+    uint16_t rx_gen[APIPC_MAX_OBJ]; /**< lease generation of the newest block
+                                      landed */
+    uint16_t held_gen[APIPC_MAX_OBJ]; /**< lease generation of pheld */
+    uint16_t lease[APIPC_MAX_OBJ]; /**< lent slot of the staging a lease write
+                                     waiting its response was put on,
+                                     APIPC_LEASE_MAX if none */
+    volatile uint16_t isr_req[APIPC_MAX_OBJ]; /**< apipc_send_isr() request
+                                                state, see APIPC_ISR_xxx */
+    uint64_t isr_timer[APIPC_MAX_OBJ]; /**< timer value apipc_send_isr() put
+                                         the obj */
 };
 
 #endif
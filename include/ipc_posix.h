@@ -0,0 +1,345 @@
+/**
+ *
+ * \file ipc_posix.h
+ *
+ * \brief POSIX shared memory IPC driver.
+ *
+ * \author Federico David Ceccarelli
+ *
+ * apipc host builds, APIPC_POSIX=1, replace the TI F2837xD device & IPC driver
+ * headers with this one. It implements the IPC driver API apipc is built on
+ * over a POSIX shared memory segment, so CPU1 & CPU2 firmwares could run as two
+ * Linux processes.
+ *
+ * The segment stands for the MSGRAM & GSxM RAM of both cores. Every core puts
+ * its messages on lock-free single producer / single consumer rings and IPC
+ * flags are shared words. Setting a flag wakes the remote process through a
+ * futex, where an interrupt thread runs the handlers registered with
+ * ipc_posix_isr() the same way the PIE would.
+ *
+ * Use example:
+ * \code{.c}
+ *      while(ipc_posix_open("/apipc") != 0)
+ *          usleep(1000);
+ *
+ *      ipc_posix_isr(IPC_INT0, apipc_ipc0_isr_handler);
+ *      ipc_posix_isr(IPC_INT1, apipc_ipc1_isr_handler);
+ *      ipc_posix_isr(IPC_INT2, apipc_ipc2_isr_handler);
+ *
+ *      apipc_init();
+ * \endcode
+ *
+ * \note tIpcMessage carries 32-bit addresses, as on the C28x, so every obj
+ * should be addressable with 32 bits. Build with -m32, or with -no-pie keeping
+ * objs on static storage. The segment is mapped at IPC_POSIX_BASE on both
+ * processes, staged data is shared between them with no extra copy.
+ */
+
+#ifndef __IPC_POSIX_H__
+#define __IPC_POSIX_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * \defgroup ipc_posix_target C28x compiler & device emulation
+ * @{ */
+#define interrupt /**< ISRs are plain functions run by the interrupt thread */
+
+#ifndef ram_func
+#define ram_func
+#endif
+
+/** ipc_posix_counter() ticks as the 200MHz IPCCOUNTER does */
+#ifndef CPU_FRQ_200MHZ
+#define CPU_FRQ_200MHZ 1
+#endif
+
+/**
+ * \brief IPC registers, only the ones ISRs write
+ *
+ * IPCACK bits written by a handler acknowledge the remote flags once the
+ * handler returns.
+ */
+struct IPC_REGS
+{
+    union
+    {
+        uint32_t all;
+        struct
+        {
+            uint16_t IPC0:1;
+            uint16_t IPC1:1;
+            uint16_t IPC2:1;
+            uint16_t IPC3:1;
+        } bit;
+    } IPCACK;
+};
+
+/**
+ * \brief PIE registers, only the IPC group ones
+ *
+ * PIEIER1 INTx13 - INTx16 enable the IPC0 - IPC3 handlers.
+ */
+struct PIE_CTRL_REGS
+{
+    union
+    {
+        uint16_t all;
+        struct
+        {
+            uint16_t INTx13:1;
+            uint16_t INTx14:1;
+            uint16_t INTx15:1;
+            uint16_t INTx16:1;
+        } bit;
+    } PIEIER1;
+    union
+    {
+        uint16_t all;
+    } PIEACK;
+};
+
+#define PIEACK_GROUP1 0x0001
+
+extern volatile struct IPC_REGS IpcRegs;
+extern volatile struct PIE_CTRL_REGS PieCtrlRegs;
+
+/** keeps the interrupt thread handlers out until __restore_interrupts() */
+uint16_t __disable_interrupts(void);
+void __restore_interrupts(uint16_t key);
+/** @}*/
+
+/**
+ * \defgroup ipc_posix_driver IPC driver API
+ *
+ * Same definitions & routines the F2837xD IPC driver provides.
+ * @{ */
+#define IPC_BUFFER_SIZE 4 /**< messages a ring holds, a slot is kept free */
+
+#define IPC_INT0 0x0001
+#define IPC_INT1 0x0002
+#define IPC_INT2 0x0003
+#define IPC_INT3 0x0004
+
+#define STATUS_FAIL 0x0001
+#define STATUS_PASS 0x0000
+
+#define ENABLE_BLOCKING 0x0001
+#define DISABLE_BLOCKING 0x0000
+
+#define NO_FLAG 0x00000000
+
+#define IPC_LENGTH_16_BITS 0x00000001
+#define IPC_LENGTH_32_BITS 0x00000002
+
+#define IPC_SET_BITS 0x00010001
+#define IPC_CLEAR_BITS 0x00010002
+#define IPC_DATA_WRITE 0x00010003
+#define IPC_BLOCK_READ 0x00010004
+#define IPC_BLOCK_WRITE 0x00010005
+#define IPC_DATA_READ_PROTECTED 0x00010007
+#define IPC_SET_BITS_PROTECTED 0x00010008
+#define IPC_CLEAR_BITS_PROTECTED 0x00010009
+#define IPC_DATA_WRITE_PROTECTED 0x0001000A
+#define IPC_BLOCK_WRITE_PROTECTED 0x0001000B
+#define IPC_FUNC_CALL 0x00000012
+
+#define IPC_GSX_CPU1_MASTER 0
+#define IPC_GSX_CPU2_MASTER 1
+
+#define GS0_ACCESS 0x00000001
+#define GS1_ACCESS 0x00000002
+#define GS2_ACCESS 0x00000004
+#define GS3_ACCESS 0x00000008
+#define GS4_ACCESS 0x00000010
+#define GS5_ACCESS 0x00000020
+#define GS6_ACCESS 0x00000040
+#define GS7_ACCESS 0x00000080
+
+#define IPC_FLAG0 0x00000001
+#define IPC_FLAG1 0x00000002
+#define IPC_FLAG2 0x00000004
+#define IPC_FLAG3 0x00000008
+#define IPC_FLAG4 0x00000010
+#define IPC_FLAG5 0x00000020
+#define IPC_FLAG6 0x00000040
+#define IPC_FLAG7 0x00000080
+#define IPC_FLAG8 0x00000100
+#define IPC_FLAG9 0x00000200
+#define IPC_FLAG10 0x00000400
+#define IPC_FLAG11 0x00000800
+
+/** IPC driver message */
+typedef struct
+{
+    uint32_t ulcommand;
+    uint32_t uladdress;
+    uint32_t uldataw1;
+    uint32_t uldataw2;
+} tIpcMessage;
+
+/** IPC driver controller, binds a put ring and a get ring */
+typedef struct
+{
+    tIpcMessage *psPutBuffer;
+    uint32_t ulPutFlag;
+    uint16_t *pusPutWriteIndex;
+    uint16_t *pusPutReadIndex;
+    tIpcMessage *psGetBuffer;
+    uint16_t *pusGetWriteIndex;
+    uint16_t *pusGetReadIndex;
+} tIpcController;
+
+void InitIpc(void);
+void IPCInitialize(volatile tIpcController *psController,
+                   uint16_t usCPU2IpcInterrupt, uint16_t usCPU1IpcInterrupt);
+uint16_t IpcPut(volatile tIpcController *psController, tIpcMessage *psMessage,
+                uint16_t bBlock);
+uint16_t IpcGet(volatile tIpcController *psController, tIpcMessage *psMessage,
+                uint16_t bBlock);
+
+uint16_t IPCLtoRDataWrite(volatile tIpcController *psController,
+                          uint32_t ulAddress, uint32_t ulData, uint16_t usLength,
+                          uint16_t bBlock, uint32_t ulResponseFlag);
+uint16_t IPCLtoRSetBits(volatile tIpcController *psController, uint32_t ulAddress,
+                        uint32_t ulMask, uint16_t usLength, uint16_t bBlock);
+uint16_t IPCLtoRClearBits(volatile tIpcController *psController, uint32_t ulAddress,
+                          uint32_t ulMask, uint16_t usLength, uint16_t bBlock);
+uint16_t IPCLtoRBlockWrite(volatile tIpcController *psController,
+                           uint32_t ulAddress, uint32_t ulShareAddress,
+                           uint16_t usLength, uint16_t usWLength, uint16_t bBlock);
+uint16_t IPCLtoRFunctionCall(volatile tIpcController *psController,
+                             uint32_t ulAddress, uint32_t ulParam, uint16_t bBlock);
+uint16_t IPCLtoRSendMessage(volatile tIpcController *psController,
+                            uint32_t ulCommand, uint32_t ulAddress,
+                            uint32_t ulDataW1, uint32_t ulDataW2, uint16_t bBlock);
+
+void IPCRtoLDataWrite(tIpcMessage *psMessage);
+void IPCRtoLSetBits(tIpcMessage *psMessage);
+void IPCRtoLClearBits(tIpcMessage *psMessage);
+void IPCRtoLBlockRead(tIpcMessage *psMessage);
+void IPCRtoLBlockWrite(tIpcMessage *psMessage);
+void IPCRtoLFunctionCall(tIpcMessage *psMessage);
+
+void IPCLtoRFlagSet(uint32_t ulFlags);
+void IPCLtoRFlagClear(uint32_t ulFlags);
+uint16_t IPCLtoRFlagBusy(uint32_t ulFlags);
+uint16_t IPCRtoLFlagBusy(uint32_t ulFlags);
+void IPCRtoLFlagAcknowledge(uint32_t ulFlags);
+/** @}*/
+
+/**
+ * \defgroup ipc_posix_shm shared memory segment layout
+ * @{ */
+
+/** segment mapping address, the same on both processes */
+#ifndef IPC_POSIX_BASE
+#define IPC_POSIX_BASE 0x50000000UL
+#endif
+
+/** MSGRAM words every core owns */
+#ifndef IPC_POSIX_MSGRAM_WORDS
+#define IPC_POSIX_MSGRAM_WORDS 0x0400
+#endif
+
+/** GSxM RAM words every core owns */
+#ifndef IPC_POSIX_GSRAM_WORDS
+#define IPC_POSIX_GSRAM_WORDS 0x3000
+#endif
+
+/** GSxM RAM alignment, apipc lays obj tables & staged data over it */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define IPC_POSIX_GSRAM_ALIGN _Alignas(max_align_t)
+#else
+#define IPC_POSIX_GSRAM_ALIGN __attribute__((aligned(__BIGGEST_ALIGNMENT__)))
+#endif
+
+/** IPC interrupts, IPC_INT0 - IPC_INT3, a core could be put messages on */
+#define IPC_POSIX_MAX_INT 4
+
+/** segment initialized mark, set by CPU1 */
+#define IPC_POSIX_MAGIC 0x49504331UL
+
+/** ring a core gets messages from, the remote core puts them */
+struct ipc_posix_ring
+{
+    tIpcMessage msg[IPC_BUFFER_SIZE];
+    uint16_t windex; /**< written by the remote core */
+    uint16_t rindex; /**< written by the owner core */
+};
+
+/** spaces a core owns */
+struct ipc_posix_core
+{
+    uint32_t flg; /**< IPC flags set by the remote core */
+    uint32_t irq; /**< interrupt futex, bumped every time a flag is set */
+    struct ipc_posix_ring ring[IPC_POSIX_MAX_INT]; /**< received messages */
+    uint16_t msgram[IPC_POSIX_MSGRAM_WORDS]; /**< MSGRAM the core writes */
+    IPC_POSIX_GSRAM_ALIGN uint16_t gsram[IPC_POSIX_GSRAM_WORDS]; /**< GSxM RAM the core masters */
+};
+
+/** shared memory segment */
+struct ipc_posix_shm
+{
+    uint32_t magic; /**< IPC_POSIX_MAGIC once CPU1 initialized it */
+    struct ipc_posix_core core[2]; /**< CPU1 & CPU2 spaces */
+};
+
+/** mapped segment */
+#define IPC_POSIX_SHM ((struct ipc_posix_shm *) IPC_POSIX_BASE)
+
+#if defined(CPU1)
+#define IPC_POSIX_LOCAL 0 /**< local core spaces */
+#define IPC_POSIX_REMOTE 1 /**< remote core spaces */
+#elif defined(CPU2)
+#define IPC_POSIX_LOCAL 1
+#define IPC_POSIX_REMOTE 0
+#endif
+/** @}*/
+
+/**
+ * \brief Map the shared memory segment and start the interrupt thread
+ *
+ * \param [in] name POSIX shared memory object name, i.e. "/apipc". Both
+ *                  processes should use the same name.
+ *
+ * \return 0 on success, -1 with errno set if not. errno EAGAIN tells CPU2 that
+ * CPU1 didn't initialize the segment yet and ipc_posix_open() should be retried.
+ *
+ * CPU1 creates a clean segment, CPU2 attaches to it. Should be called before
+ * any other IPC driver routine.
+ */
+int ipc_posix_open(const char *name);
+
+/**
+ * \brief Stop the interrupt thread and unmap the shared memory segment
+ *
+ * CPU1 also removes the shared memory object.
+ */
+void ipc_posix_close(void);
+
+/**
+ * \brief Register the handler run when the remote core sets an IPC flag
+ *
+ * \param [in] ipc_int IPC_INT0 - IPC_INT3 interrupt
+ * \param [in] handler handler to run, NULL unregisters it
+ *
+ * Handlers run on the interrupt thread while the matching PieCtrlRegs.PIEIER1
+ * bit is set and acknowledge their flag through IpcRegs.IPCACK.
+ */
+void ipc_posix_isr(uint16_t ipc_int, void (*handler)(void));
+
+/**
+ * \brief Read the emulated free-running IPCCOUNTER
+ *
+ * \return CLOCK_MONOTONIC time in 200MHz ticks. Both processes read the same
+ * counter.
+ */
+uint64_t ipc_posix_counter(void);
+
+#endif
+
+//
+// End of file.
+//
@@ -11,7 +11,11 @@
 #ifndef __IPC_UTILS_H__
 #define __IPC_UTILS_H__
 
+#if APIPC_POSIX
+#include "ipc_posix.h"
+#else
 #include "F2837xD_Ipc_Drivers.h"
+#endif
 
 #include <stddef.h>
 #include <stdint.h>
@@ -91,6 +95,90 @@ uint64_t ipc_read_timer(void);
  */
 uint16_t ipc_timer_expired(uint64_t start, uint64_t wait);
 
+/**
+ * \brief CRC32 kernel selection
+ *
+ * The portable kernel computes the reflected CRC-32 (0xEDB88320 polynomial)
+ * through slice-by-IPC_CRC32_SLICE lookup tables built by ipc_crc32_init().
+ * IPC_CRC32_SLICE could be 2, one uint16_t per step and 1K words of tables,
+ * or 4, two uint16_t per step and 2K words of tables, fit for host builds.
+ *
+ * Target builds could plug the C28x VCU accelerated kernel defining
+ * IPC_CRC32_KERNEL(crc, p, n) to a routine with the ipc_crc32() signature.
+ * Both cores must use kernels that compute the same CRC.
+ */
+#ifndef IPC_CRC32_SLICE
+#define IPC_CRC32_SLICE 2
+#endif
+
+/** CRC32 initial value */
+#define IPC_CRC32_INIT 0xFFFFFFFFUL
+
+/**
+ * \brief Build the portable CRC32 kernel lookup tables.
+ *
+ * Should be called once before any other ipc_crc32xxx() routine. Does nothing
+ * if IPC_CRC32_KERNEL is plugged.
+ */
+void ipc_crc32_init(void);
+
+/**
+ * \brief Accumulates n uint16_t size elements on a running CRC32
+ *
+ * \param [in] crc running CRC32, IPC_CRC32_INIT on the first call
+ * \param [in] p pointer to the data
+ * \param [in] n number of uint16_t size elements
+ *
+ * \return updated running CRC32. Final CRC32 is its ones complement.
+ *
+ * Every uint16_t element is processed low byte first.
+ */
+uint32_t ipc_crc32(uint32_t crc, const uint16_t *p, size_t n);
+
+/**
+ * \brief Copies n uint16_t size elements from s2 to s1 accumulating them on a
+ *        running CRC32 in the same pass
+ *
+ * \param [in] s1 pointer to a memory destination
+ * \param [in] s2 pointer to a memory source
+ * \param [in] n number of uint16_t size elements to copy
+ * \param [in] crc running CRC32, IPC_CRC32_INIT on the first call
+ *
+ * \return updated running CRC32, see ipc_crc32().
+ *
+ * \note With IPC_CRC32_KERNEL plugged the copy and the CRC run as two passes.
+ */
+uint32_t ipc_crc32_copy(uint16_t * __restrict s1, const uint16_t * __restrict s2,
+                        size_t n, uint32_t crc);
+
+/**
+ * \brief Puts a message on a controller PutBuffer without interrupting the
+ *        remote core
+ *
+ * \param [in] psController pointer to the IPC driver controller
+ * \param [in] psMessage pointer to the message to put
+ * \param [in] bBlock ENABLE_BLOCKING waits until the PutBuffer has room,
+ *                    DISABLE_BLOCKING returns at once if it is full.
+ *
+ * \return STATUS_PASS if the message was put, STATUS_FAIL if the PutBuffer
+ * was full and bBlock is DISABLE_BLOCKING.
+ *
+ * Does what IpcPut() does but the controller ulPutFlag, the remote interrupt,
+ * is left to the caller, so several messages could be put before raising it
+ * once with IPCLtoRFlagSet().
+ */
+uint16_t IpcPutNoFlag(volatile tIpcController *psController,
+                      tIpcMessage *psMessage, uint16_t bBlock);
+
+/**
+ * \brief Consults the messages a controller PutBuffer still takes
+ *
+ * \param [in] psController pointer to the IPC driver controller
+ *
+ * \return free PutBuffer slots, 0 if it is full.
+ */
+uint16_t IpcPutFree(volatile tIpcController *psController);
+
 #if defined(CPU1)
 /**
  * \brief Manage GSxM Ram memory access
@@ -17,13 +17,19 @@
  ******************************************************************************
  */
 
+#if APIPC_POSIX
+#include "ipc_posix.h"
+#else
 #include "F2837xD_device.h"        // F2837xD Headerfile Include File
 #include "F2837xD_Examples.h"      // F2837xD Examples Include File
+#endif
 
 #include "ipc.h"
 #include "../lib/mymalloc/mymalloc.h"
 #include "../lib/circular_buffer/buffer.h"
 
+#include <string.h>
+
 /**
  * \defgroup apipc_gsram_alloc apipc symbols allocation
  *
@@ -31,19 +37,43 @@
  * memory spaces and directions. Those memory spaces corresponds to gsram and
  * are defined in the .cmd file included with the project.
  *
- * \note space is allocated depending on the .cmd file included in the project
+ * \note space is allocated depending on the .cmd file included in the project,
+ * on APIPC_POSIX builds it is carved from the shared memory segment instead.
  * @{*/
+#if !APIPC_POSIX
 #pragma DATA_SECTION(cl_r_w_data,".cpul_cpur_data"); /**< cl_r_w_data is allocated to shared RAM .cpul_cpur_data space. */
 #pragma DATA_SECTION(l_apipc_obj,".base_cpul_cpur_addr"); /**< l_apipc_obj mapped to shared RAM .base_cpul_cpur_addr space. */
 #pragma DATA_SECTION(r_apipc_obj,".base_cpur_cpul_addr"); /**< r_apipc_obj mapped to shared RAM .base_cpur_cpul_addr space. */
+#pragma DATA_SECTION(apipc_ctl,".apipc_ctl"); /**< apipc_ctl mapped to core dedicated RAM .apipc_ctl space. */
+#endif
 /** @}*/
 
 /** 
  * \defgrup apipc_data_declaration ipclib shared buffers space declarations
  * @{*/
+#if !APIPC_POSIX
 uint16_t  cl_r_w_data[CL_R_W_DATA_LENGTH];   /**< Local to Remote data space */
 struct apipc_obj l_apipc_obj[APIPC_MAX_OBJ]; /**< Local apipc objects buffer. */
 struct apipc_obj r_apipc_obj[APIPC_MAX_OBJ]; /**< Remote apipc objects buffer. */
+#endif
+/** @}*/
+
+/** local apipc objects control state. */
+struct apipc_obj_ctl apipc_ctl;
+
+/**
+ * \defgroup apipc_snap snapshot buffers indexes packing
+ *
+ * Snapshot buffers roles are packed on a single word so they are swapped
+ * atomically. back is the buffer remote writes land on, middle the latest
+ * published one and front the one the reader holds.
+ * @{ */
+#define APIPC_SNAP_BACK(s)   ((s) & 0x3)
+#define APIPC_SNAP_MIDDLE(s) (((s) >> 2) & 0x3)
+#define APIPC_SNAP_FRONT(s)  (((s) >> 4) & 0x3)
+#define APIPC_SNAP_FRESH     0x0040 /**< middle is newer than front */
+#define APIPC_SNAP_HELD      0x0080 /**< reader holds front */
+#define APIPC_SNAP(b, m, f)  ((b) | ((m) << 2) | ((f) << 4))
 /** @}*/
 
 /** 
@@ -56,28 +86,362 @@ volatile tIpcController g_sIpcController1; /**< INT0 IPC Drivers handler. */
 volatile tIpcController g_sIpcController2; /**< INT1 IPC Drivers handler. */
 /** @}*/
 
-/** mymalloc API handler declaration. */
-mymalloc_handler l_r_w_data_h;
+/**
+ * \brief apipc transport lane definition
+ *
+ * Every IPC driver controller is used as an independent lane. A lane owns the
+ * queue where its received messages are stored to be processed, the count of
+ * commands it has waiting a remote response and its statistics.
+ */
+struct apipc_lane
+{
+    struct apipc_link *plink; /**< link the lane belongs to */
+    enum apipc_lane_id id; /**< lane id on his link */
+    volatile tIpcController *pctrl; /**< lane IPC Driver handler */
+    uint32_t irq_flag; /**< lane ipc interrupt flag */
+    circular_buffer_handler message_cbh; /**< received messages queue handler */
+    tIpcMessage message_array[APIPC_MAX_OBJ]; /**< ipc messages array memory allocation */
+    uint16_t inflight; /**< commands waiting remote response */
+    uint16_t pending; /**< messages put without raising the remote interrupt */
+    uint16_t rsp_pending; /**< pending messages hold a response */
+    uint64_t pending_timer; /**< timer value the first pending message was put */
+    uint16_t tx_msgs; /**< messages put on the lane, wraps */
+    uint16_t rx_taken; /**< messages taken off the lane queue, wraps */
+    volatile uint16_t rx_keyed; /**< keyed writes the ISR kept off the lane
+                                  queue, wraps */
+    volatile uint16_t rx_queued; /**< messages put on the lane queue, wraps */
+    uint16_t rx_seq; /**< lane queue messages processed, wraps */
+    struct apipc_lane_stats stats; /**< lane statistics */
+};
+
+/** how a put raises the remote interrupt, see APIPC_COALESCE_MSGS */
+enum apipc_put_mode
+{
+    APIPC_PUT_CMD = 0, /**< coalesced */
+    APIPC_PUT_URGENT, /**< raised right away */
+    APIPC_PUT_RSP /**< raised once the received messages pass is over */
+};
+
+/** apipc_send_isr() request states */
+#define APIPC_ISR_NONE 0 /**< nothing requested */
+#define APIPC_ISR_REQUESTED 1 /**< apipc_app() starts the obj once idle */
+#define APIPC_ISR_PUT 2 /**< obj was put, waiting his response */
+
+/** put mode of an obj transmition */
+#define APIPC_OBJ_PUT_MODE(obj_idx) \
+    (apipc_ctl.flag[obj_idx].urgent ? APIPC_PUT_URGENT : APIPC_PUT_CMD)
+
+/**
+ * \brief apipc latency probe definition
+ *
+ * A link has a single probe travelling at a time. See apipc_probe_send().
+ */
+struct apipc_probe
+{
+    enum apipc_lane_id lane; /**< lane monitor probes are put on */
+    uint64_t period; /**< monitor ticks between probes, 0 if stopped */
+    uint64_t timer; /**< timer value the last probe was put */
+    uint32_t tx_stamp; /**< last probe put stamp */
+    uint16_t seq; /**< last probe sequence number */
+    uint16_t busy; /**< last probe waits his echo */
+    enum apipc_lane_id tx_lane; /**< lane the last probe holds a slot of */
+    volatile uint32_t rx_stamp; /**< local ISR stamp of the last echo */
+    volatile uint16_t rx_seq; /**< sequence number of the last echo */
+    struct apipc_probe_stats stats; /**< latency distributions */
+};
+
+/**
+ * \brief apipc link definition
+ *
+ * A link connects apipc to one peer. It owns the objs tables shared with the
+ * peer, the staging pool transmitted data is copied on and the lanes its
+ * messages travel through. Objs are bound to a link by index, see
+ * apipc_obj_set_link(). APIPC_LINK_0 is the CPU1 - CPU2 link.
+ */
+struct apipc_link
+{
+    struct apipc_obj *l_obj; /**< local objs table, NULL if the link is unused */
+    struct apipc_obj *r_obj; /**< peer objs table */
+    uint16_t *pdata; /**< staging pool */
+    size_t data_len; /**< staging pool length in words */
+    mymalloc_handler data_h; /**< staging pool mymalloc handler */
+    volatile struct apipc_credit *l_credit; /**< local credits, NULL if the
+                                              link has no flow control */
+    volatile struct apipc_credit *r_credit; /**< peer credits */
+    struct apipc_lane lane[APIPC_MAX_LANE]; /**< link lanes */
+    tIpcMessage rx_key[APIPC_MAX_OBJ]; /**< newest keyed write pending per obj */
+    volatile uint16_t key_lane[APIPC_MAX_OBJ]; /**< lane the pending keyed write
+                                                 came on, APIPC_MAX_LANE if none */
+    uint16_t key_mark[APIPC_MAX_OBJ]; /**< lane rx_queued the pending keyed
+                                        write came after */
+    volatile uint16_t key_pending; /**< keyed writes pending to be applied */
+    struct apipc_probe probe; /**< latency probe */
+    uint16_t *lent[APIPC_LEASE_MAX]; /**< staging spaces lent to the peer */
+    uint16_t lent_gen[APIPC_LEASE_MAX]; /**< lease generation lent on them */
+    uint16_t *lret[APIPC_LEASE_RET]; /**< peer staging spaces to give back */
+    uint16_t lret_gen[APIPC_LEASE_RET]; /**< lease generation they landed on */
+    uint16_t lret_put[APIPC_LEASE_RET]; /**< lret release was put, waiting its
+                                          response */
+    enum apipc_lane_id lret_lane[APIPC_LEASE_RET]; /**< lane the lret release
+                                                     holds a slot of */
+    uint64_t lret_timer[APIPC_LEASE_RET]; /**< timer value the lret release
+                                            was put */
+};
+
+/** apipc links, one per peer. */
+struct apipc_link apipc_links[APIPC_MAX_LINK];
+
+/** link, local & remote descriptors of an obj */
+#define APIPC_OBJ_LINK(obj_idx) (&apipc_links[apipc_ctl.link[obj_idx]])
+#define APIPC_LOBJ(obj_idx) (&APIPC_OBJ_LINK(obj_idx)->l_obj[obj_idx])
+#define APIPC_ROBJ(obj_idx) (&APIPC_OBJ_LINK(obj_idx)->r_obj[obj_idx])
+
+/**
+ * \brief apipc image definition
+ *
+ * An image serializes every obj flagged with flag.image into one contiguous
+ * cl_r_w_data space as a sequence of [obj idx, len, data[len]] words. The image
+ * is transmitted with a single APIPC_IMAGE_WRITE command and processes his own
+ * sm, the same way an obj does.
+ */
+struct apipc_image
+{
+    uint16_t *pGSxM; /**< image space dynamically allocated on cl_r_w_data */
+    uint16_t len; /**< image length in words */
+    uint16_t nobj; /**< number of objs serialized on the image */
+    enum apipc_obj_sm img_sm; /**< actual image sm state */
+    enum apipc_lane_id tx_lane; /**< lane the image was put on */
+    uint16_t inflight; /**< image holds a tx_lane slot */
+    uint64_t timer; /**< start timer value */
+    uint16_t retry; /**< retrys counts */
+    uint16_t txn; /**< image serializes flag.txn objs instead of flag.image
+                    ones */
+};
+
+/** image membership of an obj */
+#define APIPC_IMAGE_MEMBER(pimg, obj_idx) \
+    ((pimg)->txn ? apipc_ctl.flag[obj_idx].txn : apipc_ctl.flag[obj_idx].image)
+
+/**
+ * \brief apipc remote procedure call definition
+ *
+ * Caller side record of a call waiting his return.
+ */
+struct apipc_rpc
+{
+    uint16_t *pGSxM; /**< marshalled arguments space on cl_r_w_data */
+    uint16_t *pret; /**< pointer where the result will be copied */
+    uint16_t ret_max; /**< space available on pret in words */
+    uint16_t ret_len; /**< received result length in words */
+    uint16_t gen; /**< slot generation, tells handles apart on reuse */
+    uint16_t busy; /**< call completion wasn't reported yet */
+    enum apipc_rc rc; /**< call completion */
+    enum apipc_lane_id tx_lane; /**< lane the call was put on */
+    uint64_t timer; /**< start timer value */
+};
+
+/** remote procedure calls waiting to be returned. */
+static struct apipc_rpc rpc_calls[APIPC_RPC_MAX_CALLS];
+
+/** remote procedure results waiting to be released by the caller. */
+static uint16_t *rpc_results[APIPC_RPC_MAX_CALLS];
+static uint64_t rpc_results_timer[APIPC_RPC_MAX_CALLS];
+static uint16_t rpc_results_tag[APIPC_RPC_MAX_CALLS];
+
+/** registered remote procedure handlers. */
+static apipc_rpc_handler rpc_handlers[APIPC_RPC_MAX_FUNC];
+
+/** local & remote mailboxes, reserved on the top of each MSGRAM. */
+#if APIPC_POSIX
+static volatile struct apipc_mbox *const l_mbox = (volatile struct apipc_mbox *)
+    &IPC_POSIX_SHM->core[IPC_POSIX_LOCAL].msgram[IPC_POSIX_MSGRAM_WORDS - APIPC_MBOX_SIZE];
+static volatile struct apipc_mbox *const r_mbox = (volatile struct apipc_mbox *)
+    &IPC_POSIX_SHM->core[IPC_POSIX_REMOTE].msgram[IPC_POSIX_MSGRAM_WORDS - APIPC_MBOX_SIZE];
+#elif defined( CPU1 )
+static volatile struct apipc_mbox *const l_mbox = (volatile struct apipc_mbox *) APIPC_CPU01_TO_CPU02_MBOX;
+static volatile struct apipc_mbox *const r_mbox = (volatile struct apipc_mbox *) APIPC_CPU02_TO_CPU01_MBOX;
+#elif defined( CPU2 )
+static volatile struct apipc_mbox *const l_mbox = (volatile struct apipc_mbox *) APIPC_CPU02_TO_CPU01_MBOX;
+static volatile struct apipc_mbox *const r_mbox = (volatile struct apipc_mbox *) APIPC_CPU01_TO_CPU02_MBOX;
+#endif
+
+/** APIPC_LINK_0 local & remote credits, under each mailbox. */
+#if APIPC_POSIX
+#define APIPC_L_CREDIT (volatile struct apipc_credit *) \
+    &IPC_POSIX_SHM->core[IPC_POSIX_LOCAL].msgram[IPC_POSIX_MSGRAM_WORDS - APIPC_MBOX_SIZE - APIPC_CREDIT_SIZE]
+#define APIPC_R_CREDIT (volatile struct apipc_credit *) \
+    &IPC_POSIX_SHM->core[IPC_POSIX_REMOTE].msgram[IPC_POSIX_MSGRAM_WORDS - APIPC_MBOX_SIZE - APIPC_CREDIT_SIZE]
+#elif defined( CPU1 )
+#define APIPC_L_CREDIT (volatile struct apipc_credit *) APIPC_CPU01_TO_CPU02_CREDIT
+#define APIPC_R_CREDIT (volatile struct apipc_credit *) APIPC_CPU02_TO_CPU01_CREDIT
+#elif defined( CPU2 )
+#define APIPC_L_CREDIT (volatile struct apipc_credit *) APIPC_CPU02_TO_CPU01_CREDIT
+#define APIPC_R_CREDIT (volatile struct apipc_credit *) APIPC_CPU01_TO_CPU02_CREDIT
+#endif
+
+/** registered mailbox handlers. */
+static apipc_mbox_handler mbox_handlers[APIPC_MBOX_MAX_ID];
+
+/**
+ * \brief apipc stream fragment definition
+ */
+struct apipc_frag
+{
+    uint16_t *pGSxM; /**< fragment space on cl_r_w_data, NULL if free */
+    uint32_t offset; /**< fragment offset on the block in words */
+    uint16_t len; /**< fragment length in words */
+};
+
+/**
+ * \brief apipc stream definition
+ *
+ * A stream transmits a block larger than APIPC_STREAM_CHUNK through a window
+ * of fragments. Fragments are freed as they are acknowledged and the window is
+ * refilled from apipc_app() until the whole block was put.
+ */
+struct apipc_stream
+{
+    uint16_t obj_idx; /**< streamed obj, APIPC_MAX_OBJ if the stream is free */
+    struct apipc_lane *plane; /**< lane fragments are put on */
+    uint32_t next; /**< offset of the next fragment to be put */
+    uint32_t acked; /**< words already acknowledged by the remote core */
+    struct apipc_frag frag[APIPC_STREAM_WINDOW]; /**< fragments window */
+};
+
+/** block streams. */
+static struct apipc_stream streams[APIPC_MAX_STREAM];
+
+#if APIPC_STARTUP_IMAGE
+/** startup flagged objs image. */
+static struct apipc_image startup_img;
+#endif
+
+/** transaction image and whether a transaction is open. */
+static struct apipc_image tx_img;
+static uint16_t tx_open;
+
+/** apipc initialization sm state and timeout */
+static enum apipc_init_sm init_sm = APIPC_INIT_SM_UNKNOWN;
+static uint64_t init_timer;
+static uint64_t init_timeout;
 
-/** circular_buffer handler declaration. */
-circular_buffer_handler message_cbh;
-/** ipc mesasages array memory allocation */
-tIpcMessage message_array[APIPC_MAX_OBJ];
+/** apipc_app_budgeted() time budget, 0 while apipc_app() runs unbounded. */
+static uint64_t app_budget;
+static uint64_t app_budget_timer;
+
+/** obj apipc_app() resumes from. */
+static uint16_t app_next_obj;
+
+/** apipc statistics. */
+static struct apipc_stats stats;
+
+#if APIPC_FAULT_INJECT
+/** received messages fault injection hook & delayed messages. */
+static apipc_fault_handler fault_handler;
+static tIpcMessage fault_held[APIPC_MAX_LINK * APIPC_MAX_LANE];
+static uint64_t fault_held_timer[APIPC_MAX_LINK * APIPC_MAX_LANE];
+static uint16_t fault_held_valid[APIPC_MAX_LINK * APIPC_MAX_LANE];
+#endif
 
 /** statics functions prototipes declarations
 * @{*/
-static void apipc_sram_acces_config(void);
-static void apipc_check_remote_cpu_init(void);
+static enum apipc_rc apipc_sram_acces_config(void);
+static enum apipc_rc apipc_check_remote_cpu_init(void);
 static void apipc_init_objs(void);
-static void apipc_proc_obj(struct apipc_obj *plobj);
-static void apipc_cmd_response (tIpcMessage *psMessage);
-static void apipc_message_handler (tIpcMessage *psMessage);
+static void apipc_init_links(void);
+static struct apipc_lane *apipc_lane_pick(struct apipc_link *plink,
+                                          enum apipc_lane_id lane);
+static struct apipc_lane *apipc_obj_lane(uint16_t obj_idx);
+static enum apipc_rc apipc_flags_bits(uint16_t obj_idx, uint32_t ulCommand,
+                                      uint32_t bmask);
+static void apipc_lane_drain(struct apipc_lane *plane);
+static uint16_t apipc_keyed_store(struct apipc_lane *plane, tIpcMessage *psMessage);
+static uint16_t apipc_keyed_proc(uint16_t max_msgs);
+static uint16_t apipc_keyed_flush(struct apipc_lane *plane, uint16_t seq,
+                                  uint16_t max_msgs);
+static uint16_t apipc_keyed_take(struct apipc_link *plink, uint16_t obj_idx,
+                                 tIpcMessage *psMessage);
+static void apipc_keyed_apply(tIpcMessage *psMessage);
+static void apipc_inline_apply(struct apipc_link *plink, tIpcMessage *psMessage);
+static uint16_t apipc_lease_slot(struct apipc_link *plink);
+static void apipc_lease_land(struct apipc_link *plink, tIpcMessage *psMessage);
+static void apipc_lease_return(struct apipc_link *plink, uint16_t *p,
+                               uint16_t gen);
+static void apipc_lease_free(struct apipc_link *plink, tIpcMessage *psMessage);
+static void apipc_lease_acked(struct apipc_link *plink, tIpcMessage *psMessage);
+static void apipc_lease_drop(uint16_t obj_idx);
+static void apipc_lease_proc(void);
+static enum apipc_rc apipc_probe_put(struct apipc_link *plink,
+                                     enum apipc_lane_id lane);
+static void apipc_probe_stamp(struct apipc_lane *plane, tIpcMessage *psMessage);
+static void apipc_probe_echo(struct apipc_lane *plane, tIpcMessage *psMessage);
+static void apipc_probe_done(struct apipc_link *plink, tIpcMessage *psMessage);
+static void apipc_probe_sample(struct apipc_probe_dist *pdist, uint32_t ticks);
+static void apipc_probe_reset(struct apipc_probe *pprobe);
+static void apipc_probe_proc(void);
+static uint16_t apipc_put(struct apipc_lane *plane, uint32_t ulCommand,
+                          uint32_t ulAddress, uint32_t ulDataW1,
+                          uint32_t ulDataW2, enum apipc_put_mode mode);
+static uint16_t apipc_put_keyed(struct apipc_lane *plane, uint16_t obj_idx,
+                                enum apipc_put_mode mode);
+static void apipc_isr_proc(void);
+static void apipc_lane_raise(struct apipc_lane *plane);
+static void apipc_lane_flush(uint16_t rsp);
+static uint16_t apipc_lane_held(struct apipc_lane *plane);
+static void apipc_lane_take(struct apipc_lane *plane);
+static void apipc_lane_give(struct apipc_lane *plane, uint16_t n);
+static void apipc_lane_publish(struct apipc_lane *plane);
+static void apipc_obj_release(uint16_t obj_idx);
+static enum apipc_rc apipc_image_build(struct apipc_image *pimg);
+static void apipc_image_release(struct apipc_image *pimg);
+static void apipc_image_unslot(struct apipc_image *pimg);
+static void apipc_image_retry(struct apipc_image *pimg);
+static void apipc_image_proc(struct apipc_image *pimg);
+static void apipc_image_apply(struct apipc_link *plink, tIpcMessage *psMessage);
+static void apipc_image_response(tIpcMessage *psMessage);
+static enum apipc_rc apipc_stream_start(uint16_t obj_idx,
+                                        struct apipc_lane *plane);
+static uint16_t apipc_stream_fill(struct apipc_stream *pstream);
+static void apipc_stream_release(uint16_t obj_idx);
+static enum apipc_rc apipc_stream_response(tIpcMessage *psMessage);
+static void apipc_stream_proc(void);
+static uint16_t apipc_delta_size(uint16_t obj_idx);
+static uint16_t apipc_delta_pack(uint16_t obj_idx, uint16_t *pdst,
+                                 uint16_t size);
+static void apipc_delta_apply(struct apipc_link *plink, tIpcMessage *psMessage);
+static void apipc_rx_notify(struct apipc_link *plink, tIpcMessage *psMessage);
+static void apipc_rx_landed(uint16_t obj_idx);
+static void apipc_rpc_serve(struct apipc_lane *plane, tIpcMessage *psMessage);
+static void apipc_rpc_return(struct apipc_lane *plane, tIpcMessage *psMessage);
+static void apipc_rpc_release(tIpcMessage *psMessage);
+static void apipc_rpc_proc(void);
+static void apipc_proc_obj(uint16_t obj_idx);
+static uint16_t apipc_budget_expired(void);
+static void *apipc_stage_alloc(struct apipc_link *plink, size_t len);
+static void apipc_stage_free(void *p);
+static void apipc_obj_done(uint16_t obj_idx);
+static void apipc_obj_retry(uint16_t obj_idx);
+static enum apipc_rc apipc_crc_apply(tIpcMessage *psMessage);
+static enum apipc_rc apipc_stage(uint16_t obj_idx);
+static void apipc_cmd_response (struct apipc_lane *plane, tIpcMessage *psMessage);
+static void apipc_message_handler (struct apipc_link *plink,
+                                   tIpcMessage *psMessage);
 static enum apipc_rc apipc_write(uint16_t obj_idx);
+#if !APIPC_POLLED
 static enum apipc_rc apipc_process_messages(void);
+#endif
+static enum apipc_rc apipc_message_proc(struct apipc_lane *plane,
+                                        tIpcMessage *psMessage);
+static uint16_t apipc_mbox_dispatch(void);
+static enum apipc_rc apipc_message_recv(struct apipc_lane *plane,
+                                        tIpcMessage *psMessage);
+#if APIPC_FAULT_INJECT
+static void apipc_fault_proc(void);
+#endif
 /** @}*/
 
 /* apipc_sram_acces_config: */
-static void apipc_sram_acces_config(void)
+static enum apipc_rc apipc_sram_acces_config(void)
 {
     /*
      * Each CPU owns different GSxM blocks of memory to send data & pointer address
@@ -102,17 +466,17 @@ static void apipc_sram_acces_config(void)
      * CPU2 has nothing to do here besides wait
      */
     
-    /* Wait here until CPU01 has started */
-    while(IPCRtoLFlagBusy(APIPC_FLAG_SRAM_ACCES) != 1)
-    {
-	// TODO: this wait should be timed
-    }
+    /* Check if CPU01 has already started */
+    if(IPCRtoLFlagBusy(APIPC_FLAG_SRAM_ACCES) != 1)
+        return APIPC_RC_PENDING;
 
 #endif
+
+    return APIPC_RC_SUCCESS;
 }
 
 /* apipc_check_remote_cpu_init: */
-static void apipc_check_remote_cpu_init(void)
+static enum apipc_rc apipc_check_remote_cpu_init(void)
 {
 
 #if defined ( CPU1 )
@@ -122,592 +486,3904 @@ static void apipc_check_remote_cpu_init(void)
 
 #elif defined ( CPU2 )
 
-    /* Wait here until CPU1 has started */
-    while(IPCRtoLFlagBusy(APIPC_FLAG_API_INITED) != 1)
-    {
-	// TODO: this wait should be timed
-    }
+    /* Check if CPU1 has already started */
+    if(IPCRtoLFlagBusy(APIPC_FLAG_API_INITED) != 1)
+        return APIPC_RC_PENDING;
 
     /* apipc cpu2 inited */
     IPCLtoRFlagSet(APIPC_FLAG_API_INITED);
 #endif
 
+    return APIPC_RC_SUCCESS;
 }
 
 /* apipc_init_objs: */
 static void apipc_init_objs(void)
 {
     uint16_t obj_idx;
-    struct apipc_obj *plobj;
+    uint16_t link_idx;
+    struct apipc_link *plink;
 
-    plobj = l_apipc_obj;
+    plink = apipc_links;
 
-    /* objs are initialized making sure that paddr == NULL */
-    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++, plobj++)
-        plobj->paddr = NULL;
-}
+    /* objs are initialized making sure that paddr == NULL on every link */
+    for(link_idx = 0; link_idx < APIPC_MAX_LINK; link_idx++, plink++)
+        if(plink->l_obj != NULL)
+            for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+                plink->l_obj[obj_idx].paddr = NULL;
 
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+        apipc_ctl.link[obj_idx] = APIPC_LINK_0;
 
- /* apipc_init: Initialize ipc API  */
-void apipc_init(void)
+    for(obj_idx = 0; obj_idx < APIPC_MAX_STREAM; obj_idx++)
+        streams[obj_idx].obj_idx = APIPC_MAX_OBJ;
+}
+
+/* apipc_init_links: */
+static void apipc_init_links(void)
 {
+    uint16_t link_idx;
+    uint16_t lane_idx;
+    uint16_t obj_idx;
+    struct apipc_link *plink;
+    struct apipc_lane *plane;
+
+    /* CPU1 - CPU2 link lives on the statically linked GSxM spaces and his
+     * lanes are the IPC_INT0 & IPC_INT1 controllers */
+    plink = &apipc_links[APIPC_LINK_0];
+#if APIPC_POSIX
+    /* host builds: objects tables first, staging data after them */
+    plink->l_obj = (struct apipc_obj *) IPC_POSIX_SHM->core[IPC_POSIX_LOCAL].gsram;
+    plink->r_obj = (struct apipc_obj *) IPC_POSIX_SHM->core[IPC_POSIX_REMOTE].gsram;
+    plink->pdata = (uint16_t *) (plink->l_obj + APIPC_MAX_OBJ);
+    plink->data_len = IPC_POSIX_GSRAM_WORDS -
+                      APIPC_MAX_OBJ * sizeof(struct apipc_obj) / sizeof(uint16_t);
+#else
+    plink->l_obj = l_apipc_obj;
+    plink->r_obj = r_apipc_obj;
+    plink->pdata = cl_r_w_data;
+    plink->data_len = CL_R_W_DATA_LENGTH;
+#endif
+    plink->lane[APIPC_LANE_0].pctrl = &g_sIpcController1;
+    plink->lane[APIPC_LANE_1].pctrl = &g_sIpcController2;
+    plink->lane[APIPC_LANE_0].irq_flag = APIPC_FLAG_IRQ_IPC0;
+    plink->lane[APIPC_LANE_1].irq_flag = APIPC_FLAG_IRQ_IPC1;
+    plink->l_credit = APIPC_L_CREDIT;
+    plink->r_credit = APIPC_R_CREDIT;
 
-    /* Initialize peripheral IPC device to a known state */
-    InitIpc();
+    plink = apipc_links;
 
-    /* Initializes System IPC driver controller */
-    IPCInitialize(&g_sIpcController1, IPC_INT0, IPC_INT0);
-    IPCInitialize(&g_sIpcController2, IPC_INT1, IPC_INT1);
+    for(link_idx = 0; link_idx < APIPC_MAX_LINK; link_idx++, plink++)
+    {
+        if(plink->l_obj == NULL)
+            continue;
 
-    /* Set GSxM blocks property */
-    apipc_sram_acces_config();
+        /* Initialize mymalloc handler to allocate the link staging pool
+         * dynamically */
+        plink->data_h = mymalloc_init_array((void *)plink->pdata, plink->data_len);
 
-    /* Initialize mymalloc handler to allocate cl_r_w_data data dynamically */
-    l_r_w_data_h = mymalloc_init_array((void*)cl_r_w_data, (size_t)CL_R_W_DATA_LENGTH);
+        for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+            plink->key_lane[obj_idx] = APIPC_MAX_LANE;
+        plink->key_pending = 0;
 
-    /* Initialize circular_buffer  handler to manage an array of tIpcMessage dynamically */
-    message_cbh = circular_buffer_init((void *)&message_array, sizeof(tIpcMessage),
-                                  (uint16_t)APIPC_MAX_OBJ);
+        memset(&plink->probe, 0, sizeof(plink->probe));
+        apipc_probe_reset(&plink->probe);
 
-    /* initialize the objs array to a known state */
-    apipc_init_objs();
+        memset(plink->lent, 0, sizeof(plink->lent));
+        memset(plink->lret, 0, sizeof(plink->lret));
+        memset(plink->lret_put, 0, sizeof(plink->lret_put));
 
-    /* Set up IPC interrupts PIEIERx Registers */
-    PieCtrlRegs.PIEIER1.bit.INTx13 = 1; // Set the apropropiate PIEIERx bit for IPC0
-    PieCtrlRegs.PIEIER1.bit.INTx14 = 1; // Set the apropropiate PIEIERx bit for IPC1
+        plane = plink->lane;
 
-    /* Acknowledge Local CPU start & wait here until Remote CPU init */
-    apipc_check_remote_cpu_init();
+        for(lane_idx = 0; lane_idx < APIPC_MAX_LANE; lane_idx++, plane++)
+        {
+            /* Initialize circular_buffer handler to manage an array of
+             * tIpcMessage dynamically */
+            plane->message_cbh = circular_buffer_init((void *)plane->message_array,
+                                                      sizeof(tIpcMessage),
+                                                      (uint16_t)APIPC_MAX_OBJ);
+            plane->plink = plink;
+            plane->id = (enum apipc_lane_id)lane_idx;
+            plane->inflight = 0;
+            plane->pending = 0;
+            plane->rsp_pending = 0;
+            plane->tx_msgs = 0;
+            plane->rx_taken = 0;
+            plane->rx_keyed = 0;
+            plane->rx_queued = 0;
+            plane->rx_seq = 0;
+            memset(&plane->stats, 0, sizeof(plane->stats));
+
+            if(plink->l_credit != NULL)
+                plink->l_credit->rx_done[lane_idx] = 0;
+        }
+    }
 }
 
-/* apipc_register_obj: register data as an apipc obj to be able to be tranfer
- * between cores */
-enum apipc_rc apipc_register_obj(uint16_t obj_idx, enum apipc_obj_type obj_type,
-                                 void *paddr, size_t size, uint16_t startup)
+/* apipc_lane_pick: retrieve the link lane a transmition should be put on */
+static struct apipc_lane *apipc_lane_pick(struct apipc_link *plink,
+                                          enum apipc_lane_id lane)
 {
-    enum apipc_rc rc;
-    struct apipc_obj *plobj;
-
-    rc = APIPC_RC_SUCCESS;
-    plobj = &l_apipc_obj[obj_idx];
+    struct apipc_lane *plane0;
+    struct apipc_lane *plane1;
 
-    if(plobj->paddr != NULL)
-        return APIPC_RC_FAIL;
+    if(lane < APIPC_MAX_LANE)
+        return &plink->lane[lane];
 
-    plobj->idx = obj_idx;
-    plobj->type = obj_type;
-    plobj->obj_sm = APIPC_OBJ_SM_UNKNOWN;
-    plobj->paddr = paddr;
-    plobj->len = size;
+    plane0 = &plink->lane[APIPC_LANE_0];
+    plane1 = &plink->lane[APIPC_LANE_1];
 
-    if(startup)
-        plobj->flag.startup = 1;
-    else
-        plobj->flag.startup = 0;
+    /* spread objs by load. On a tie keep IPC_INT1 lane, the historic one */
+    if(plane0->inflight < plane1->inflight)
+        return plane0;
 
-    return rc;
+    return plane1;
 }
 
-/* apipc_obj_state: consult the actual state of the obj_idx object sm. */
-enum apipc_obj_sm apipc_obj_state(uint16_t obj_idx)
+/* apipc_obj_lane: retrieve the lane an obj transmition should be put on. An
+ * obj with commands still waiting their response keeps their lane, so the
+ * remote core applies its keyed writes & set or clear bits in order */
+static struct apipc_lane *apipc_obj_lane(uint16_t obj_idx)
 {
-    struct apipc_obj *plobj;
+    if(apipc_ctl.flag[obj_idx].inflight || apipc_ctl.bits[obj_idx])
+        return &APIPC_OBJ_LINK(obj_idx)->lane[apipc_ctl.tx_lane[obj_idx]];
 
-    plobj = &l_apipc_obj[obj_idx];
-    return plobj->obj_sm;
+    return apipc_lane_pick(APIPC_OBJ_LINK(obj_idx), apipc_ctl.lane[obj_idx]);
 }
 
-
-/* apipc_send: request transfer an object on demand. */
-ram_func enum apipc_rc apipc_send(uint16_t obj_idx)
+/* apipc_put: put a message on the lane driver PutBuffer, the remote interrupt
+ * is raised as mode and APIPC_COALESCE_MSGS say. Interrupts are kept out,
+ * apipc_send_isr() puts too */
+static uint16_t apipc_put(struct apipc_lane *plane, uint32_t ulCommand,
+                          uint32_t ulAddress, uint32_t ulDataW1,
+                          uint32_t ulDataW2, enum apipc_put_mode mode)
 {
-    enum apipc_rc rc;
-    struct apipc_obj *plobj;
+    tIpcMessage sMessage;
+    uint16_t key;
 
-    rc = APIPC_RC_SUCCESS;
-    plobj = &l_apipc_obj[obj_idx];
+    sMessage.ulcommand = ulCommand;
+    sMessage.uladdress = ulAddress;
+    sMessage.uldataw1 = ulDataW1;
+    sMessage.uldataw2 = ulDataW2;
 
-    if(plobj->obj_sm == APIPC_OBJ_SM_IDLE)
-        plobj->obj_sm = APIPC_OBJ_SM_INIT;
-    else
-        rc = APIPC_RC_FAIL;
+    key = __disable_interrupts();
 
-    return rc;
-}
+    /* PutBuffer full, the remote core should drain what is pending */
+    if(STATUS_FAIL == IpcPutNoFlag(plane->pctrl, &sMessage, DISABLE_BLOCKING))
+    {
+        apipc_lane_raise(plane);
+        __restore_interrupts(key);
+        return STATUS_FAIL;
+    }
 
-/* apipc_flags_set_bits: Sets the designated bits at the remote CPU obj */
-enum apipc_rc apipc_flags_set_bits(uint16_t obj_idx, uint32_t bmask)
-{
+    plane->tx_msgs++;
 
-    enum apipc_rc rc;
-    struct apipc_obj *plobj;
-    struct apipc_obj *probj;
+    if(plane->pending++ == 0)
+        plane->pending_timer = ipc_read_timer();
 
-    rc = APIPC_RC_SUCCESS;
-    plobj = &l_apipc_obj[obj_idx];
-    probj = &r_apipc_obj[obj_idx];
+    if(mode == APIPC_PUT_RSP)
+        plane->rsp_pending = 1;
 
-    if(STATUS_FAIL == IPCLtoRSetBits(&g_sIpcController2, (uint32_t)probj->paddr, bmask, (uint16_t)plobj->len,
-                DISABLE_BLOCKING))
-        rc = APIPC_RC_FAIL;
+    if(mode == APIPC_PUT_URGENT || plane->pending >= APIPC_COALESCE_MSGS ||
+       IpcPutFree(plane->pctrl) == 0)
+        apipc_lane_raise(plane);
 
-    return rc;
+    __restore_interrupts(key);
+
+    return STATUS_PASS;
 }
 
-/* apipc_flags_set_bits: Clear the designated bits at the remote CPU obj */
-enum apipc_rc apipc_flags_clear_bits(uint16_t obj_idx, uint32_t bmask)
+/* apipc_put_keyed: put the whole value of a DATA or FLAGS obj as a keyed
+ * write */
+static uint16_t apipc_put_keyed(struct apipc_lane *plane, uint16_t obj_idx,
+                                enum apipc_put_mode mode)
 {
-
-    enum apipc_rc rc;
     struct apipc_obj *plobj;
-    struct apipc_obj *probj;
+    uint32_t ulData;
 
-    rc = APIPC_RC_SUCCESS;
-    plobj = &l_apipc_obj[obj_idx];
-    probj = &r_apipc_obj[obj_idx];
+    plobj = APIPC_LOBJ(obj_idx);
 
-    if(STATUS_FAIL == IPCLtoRClearBits(&g_sIpcController2, (uint32_t)probj->paddr, bmask, (uint16_t)plobj->len,
-                DISABLE_BLOCKING))
-        rc = APIPC_RC_FAIL;
+    /* retrieve obj data length */
+    if(plobj->len == IPC_LENGTH_16_BITS)
+        ulData = (uint32_t) *(uint16_t *)plobj->paddr;
 
-    return rc;
+    else if(plobj->len == IPC_LENGTH_32_BITS)
+        ulData = (uint32_t) *(uint32_t *)plobj->paddr;
+
+    else
+        return STATUS_FAIL;
+
+    /* the whole value is written, flags included, so a newer write
+     * supersedes the ones still pending on the remote core */
+    apipc_ctl.gen[obj_idx]++;
+
+    return apipc_put(plane, APIPC_KEYED_WRITE, (uint32_t)(uintptr_t)APIPC_ROBJ(obj_idx)->paddr,
+                     APIPC_KEYED_W1(apipc_ctl.gen[obj_idx], obj_idx, plobj->len),
+                     ulData, mode);
 }
 
-/* apipc_write: to transmit a value to the remote core apipc interacts with the
- * ipc driver according to the obj type */
-static enum apipc_rc apipc_write(uint16_t obj_idx)
+/* apipc_lane_raise: raise the remote interrupt, the remote ISR drains every
+ * message pending on the lane */
+static void apipc_lane_raise(struct apipc_lane *plane)
 {
-    enum apipc_rc rc;
+    uint16_t key;
 
-    struct apipc_obj *plobj;
-    struct apipc_obj *probj;
+    key = __disable_interrupts();
 
-    uint32_t ulData;
-    uint32_t ulMask;
+    IPCLtoRFlagSet(plane->pctrl->ulPutFlag);
 
-    /* initialize local variables */
-    rc = APIPC_RC_SUCCESS;
-    plobj = &l_apipc_obj[obj_idx];
-    probj = &r_apipc_obj[obj_idx];
+    plane->stats.irq_raised++;
+    plane->pending = 0;
+    plane->rsp_pending = 0;
 
-    /* Check that l & r objects were initialized */
-    if( (probj->paddr == NULL) || (plobj->paddr == NULL) )
-        return APIPC_RC_FAIL;
+    __restore_interrupts(key);
+}
 
-        /* request ipc api write according to the obj type */
-    switch(plobj->type)
-    {
-        case APIPC_OBJ_TYPE_BLOCK:
+/* apipc_lane_held: check if commands should be held on a lane, the remote
+ * queue has only the credits kept for responses left */
+static uint16_t apipc_lane_held(struct apipc_lane *plane)
+{
+    uint16_t used;
 
-            /* Allocates spaces for a block on the statically reserved mem space */
-            plobj->pGSxM = (uint16_t *) mymalloc(l_r_w_data_h, plobj->len);
+    if(plane->plink->r_credit == NULL)
+        return 0;
 
-            if(plobj->pGSxM == NULL)
-            {
-                rc = APIPC_RC_FAIL;
-                break; 
-            }
+    used = plane->tx_msgs - plane->plink->r_credit->rx_done[plane->id];
 
-            /* Place data to be writen in shared memory */
-            u16memcpy(plobj->pGSxM, plobj->paddr, plobj->len);
+    return (used + APIPC_CREDIT_RESERVE >= APIPC_MAX_OBJ);
+}
 
-            /* request ipc driver write */
-            if(STATUS_FAIL == IPCLtoRBlockWrite(&g_sIpcController2,
-                                                (uint32_t)probj->paddr, 
-                                                (uint32_t)plobj->pGSxM,
-                                                (uint16_t)plobj->len,
-                                                IPC_LENGTH_16_BITS, DISABLE_BLOCKING))
-            {
-                myfree(l_r_w_data_h, plobj->pGSxM);
-                plobj->pGSxM = NULL;
-                rc = APIPC_RC_FAIL;
-            }
-            break;
+/* apipc_lane_take: hold a lane slot until a response is received. Interrupts
+ * are kept out, apipc_send_isr() takes slots too */
+static void apipc_lane_take(struct apipc_lane *plane)
+{
+    uint16_t key;
 
-        case APIPC_OBJ_TYPE_DATA:
+    key = __disable_interrupts();
 
-            /* retrieve obj data length */
-            if(plobj->len == IPC_LENGTH_16_BITS)
-                ulData = (uint32_t) *(uint16_t *)plobj->paddr;
+    if(++plane->inflight > plane->stats.inflight_max)
+        plane->stats.inflight_max = plane->inflight;
 
-            else if(plobj->len > IPC_LENGTH_32_BITS)
-                ulData = (uint32_t) *(uint32_t *)plobj->paddr;
+    __restore_interrupts(key);
+}
 
-            else
-            {
-                rc = APIPC_RC_FAIL;
-                break;
-            }
+/* apipc_lane_give: give n lane slots back */
+static void apipc_lane_give(struct apipc_lane *plane, uint16_t n)
+{
+    uint16_t key;
 
-            /* request ipc driver write */
-            if(STATUS_FAIL == IPCLtoRDataWrite(&g_sIpcController2,
-                                               (uint32_t)probj->paddr,
-                                               ulData, (uint16_t)plobj->len,
-                                               DISABLE_BLOCKING, NO_FLAG))
-                rc = APIPC_RC_FAIL;
-            break;
+    key = __disable_interrupts();
 
-        case APIPC_OBJ_TYPE_FLAGS:
+    plane->inflight -= n;
 
-            /* retrieve obj data length */
-            if(plobj->len == IPC_LENGTH_16_BITS)
-                ulMask = (uint32_t) *(uint16_t *)plobj->paddr;
+    __restore_interrupts(key);
+}
 
-            else if(plobj->len > IPC_LENGTH_32_BITS)
-                ulMask = (uint32_t) *(uint32_t *)plobj->paddr;
+/* apipc_lane_publish: publish the messages taken off a lane queue, queue drops
+ * included, so the peer knows its credits */
+static void apipc_lane_publish(struct apipc_lane *plane)
+{
+    if(plane->plink->l_credit == NULL)
+        return;
 
-            /* request ipc driver write */
-            if( APIPC_RC_FAIL == apipc_flags_set_bits(plobj->idx, ulMask))
-                rc = APIPC_RC_FAIL;
+    plane->plink->l_credit->rx_done[plane->id] = plane->rx_taken +
+                                                 plane->rx_keyed +
+                                                 (uint16_t)plane->stats.rx_drop;
+}
 
-            /* request ipc driver write */
-            if( APIPC_RC_FAIL == apipc_flags_clear_bits(plobj->idx, ~ulMask))
-                rc = APIPC_RC_FAIL;
+/* apipc_lane_flush: raise the remote interrupt of lanes holding responses,
+ * if rsp, or messages pending longer than APIPC_COALESCE_TICKS */
+static void apipc_lane_flush(uint16_t rsp)
+{
+    uint16_t link_idx;
+    uint16_t lane_idx;
+    struct apipc_link *plink;
+    struct apipc_lane *plane;
 
-            break;
+    plink = apipc_links;
 
-        case APIPC_OBJ_TYPE_FUNC_CALL:
+    for(link_idx = 0; link_idx < APIPC_MAX_LINK; link_idx++, plink++)
+    {
+        if(plink->l_obj == NULL)
+            continue;
 
-            /* retrieve function obj type argument */
-            ulData = (uint32_t) plobj->payload;
+        plane = plink->lane;
 
-            /* request ipc driver write */
-            if(STATUS_FAIL == IPCLtoRFunctionCall(&g_sIpcController2,
-                                               (uint32_t)probj->paddr, ulData,
-                                               DISABLE_BLOCKING))
-                rc = APIPC_RC_FAIL;
-            break;
+        for(lane_idx = 0; lane_idx < APIPC_MAX_LANE; lane_idx++, plane++)
+        {
+            if(!plane->pending)
+                continue;
 
-        default:
-            break;
+            if(rsp ? plane->rsp_pending :
+               ipc_timer_expired(plane->pending_timer, APIPC_COALESCE_TICKS))
+                apipc_lane_raise(plane);
+        }
     }
-
-    return rc;
 }
 
-/* apipc_proc_obj - apipc obj state machine process */
-static void apipc_proc_obj(struct apipc_obj *plobj)
+/* apipc_obj_release: give back the obj staging memory and lane slot */
+static void apipc_obj_release(uint16_t obj_idx)
 {
-    switch(plobj->obj_sm)
+    /* a lent staging is kept for retransmitions, see apipc_lease_drop() */
+    if(apipc_ctl.pGSxM[obj_idx] && apipc_ctl.lease[obj_idx] == APIPC_LEASE_MAX)
     {
-        case APIPC_OBJ_SM_UNKNOWN:
-            if(plobj->paddr == NULL)
-            {
-                plobj->obj_sm = APIPC_OBJ_SM_FREE;
-                break;
-            }
-            if(!plobj->flag.startup)
-            {
-                plobj->obj_sm = APIPC_OBJ_SM_IDLE;
-                break;
-            }
+        apipc_stage_free(apipc_ctl.pGSxM[obj_idx]);
+        apipc_ctl.pGSxM[obj_idx] = NULL;
+    }
 
-        /* obj transmition process starst here */
-        case APIPC_OBJ_SM_INIT:
-        /* 
-         * Every obj transmit process starts through this state.
-         */
-                plobj->retry = 3;
-                plobj->obj_sm = APIPC_OBJ_SM_WRITING;
+    if(apipc_ctl.flag[obj_idx].stream)
+        apipc_stream_release(obj_idx);
 
-        case APIPC_OBJ_SM_WRITING:
+    if(apipc_ctl.flag[obj_idx].inflight)
+    {
+        apipc_lane_give(&APIPC_OBJ_LINK(obj_idx)->lane[apipc_ctl.tx_lane[obj_idx]], 1);
+        apipc_ctl.flag[obj_idx].inflight = 0;
+    }
+}
 
-            if(apipc_write(plobj->idx) == APIPC_RC_SUCCESS)
-            {
-                plobj->timer = ipc_read_timer();
-                plobj->obj_sm = APIPC_OBJ_SM_WAITTING_RESPONSE;
-            }
-            else if (plobj->retry)
-            {
-                plobj->timer = ipc_read_timer();
-                plobj->retry--;
-                plobj->obj_sm = APIPC_OBJ_SM_RETRY;
-            }
-            else
-            {
-                if(plobj->pGSxM)
-                {
-                    myfree(l_r_w_data_h, plobj->pGSxM);
-                    plobj->pGSxM = NULL;
-                }
+/* apipc_stage_alloc: allocate a staging space on the link pool */
+static void *apipc_stage_alloc(struct apipc_link *plink, size_t len)
+{
+    void *p;
 
-                plobj->obj_sm = APIPC_OBJ_SM_FAIL;
-                plobj->flag.error = 1;
-            }
-            break;
+    p = mymalloc(plink->data_h, len);
 
-        case APIPC_OBJ_SM_WAITTING_RESPONSE:
+    if(p == NULL)
+    {
+        stats.stage_fail++;
+        return p;
+    }
 
-            if(ipc_timer_expired(plobj->timer, IPC_TIMER_WAIT_5mS))
-            {
-                if(plobj->pGSxM)
-                {
-                    myfree(l_r_w_data_h, plobj->pGSxM);
-                    plobj->pGSxM = NULL;
-                }
+    if(++stats.stage_live > stats.stage_max)
+        stats.stage_max = stats.stage_live;
 
-                if (plobj->retry)
-                {
-                    plobj->timer = ipc_read_timer();
-                    plobj->retry--;
-                    plobj->obj_sm = APIPC_OBJ_SM_RETRY;
-                    break;
-                }
-                plobj->obj_sm = APIPC_OBJ_SM_FAIL;
-                plobj->flag.error = 1;
-            }
-            break;
+    return p;
+}
 
-        case APIPC_OBJ_SM_RETRY:
+/* apipc_stage_free: give back a staging space to the link pool it was
+ * allocated on */
+static void apipc_stage_free(void *p)
+{
+    uint16_t link_idx;
+    struct apipc_link *plink;
 
-            if(ipc_timer_expired(plobj->timer, IPC_TIMER_WAIT_5mS))
-            {
-                plobj->obj_sm = APIPC_OBJ_SM_WRITING;
-            }
-            break;
+    plink = apipc_links;
 
-        case APIPC_OBJ_SM_FAIL:
-            if(!plobj->flag.startup)
-                plobj->obj_sm = APIPC_OBJ_SM_IDLE;
-            break;
+    for(link_idx = 0; link_idx < APIPC_MAX_LINK; link_idx++, plink++)
+    {
+        if(plink->l_obj == NULL || (uint16_t *)p < plink->pdata ||
+           (uint16_t *)p >= plink->pdata + plink->data_len)
+            continue;
 
-            /* obj is started and idle ready to transmit */
-        case APIPC_OBJ_SM_IDLE:
-            break;
-            /* obj is free, do nothing */
-        case APIPC_OBJ_SM_FREE:
-            break;
+        myfree(plink->data_h, p);
+        stats.stage_live--;
+        return;
     }
 }
 
-/* apipc_cmd_response - apipc response the received message over ipc to ack
- * reception */
-static void apipc_cmd_response (tIpcMessage *psMessage)
+/* apipc_obj_done: obj transmition was acknowledged by the remote core */
+static void apipc_obj_done(uint16_t obj_idx)
 {
-    enum apipc_msg_cmd cmd_response;
-     uint16_t *urAddess = NULL;
-     uint32_t ulDataW1 = 0;
+    uint64_t elapsed;
+
+    apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_IDLE;
+
+    stats.tx_done++;
+    stats.tx_words += APIPC_LOBJ(obj_idx)->len;
+
+    /* obj recovered from losses */
+    if(apipc_ctl.recover[obj_idx])
+    {
+        elapsed = ipc_read_timer() - apipc_ctl.recover[obj_idx];
+
+        if(elapsed > stats.recovery_max)
+            stats.recovery_max = elapsed;
+
+        apipc_ctl.recover[obj_idx] = 0;
+    }
+}
+
+/* apipc_obj_retry: schedule an obj retransmition, or give it up once it run
+ * out of retries */
+static void apipc_obj_retry(uint16_t obj_idx)
+{
+    if (apipc_ctl.retry[obj_idx])
+    {
+        apipc_ctl.timer[obj_idx] = ipc_read_timer();
+        apipc_ctl.retry[obj_idx]--;
+        apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_RETRY;
+
+        stats.retry++;
+        if(!apipc_ctl.recover[obj_idx])
+            apipc_ctl.recover[obj_idx] = apipc_ctl.timer[obj_idx];
+        return;
+    }
+
+    apipc_lease_drop(obj_idx);
+    apipc_obj_release(obj_idx);
+
+    apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_FAIL;
+    apipc_ctl.flag[obj_idx].error = 1;
+
+    stats.fail++;
+    apipc_ctl.recover[obj_idx] = 0;
+}
+
+ /* apipc_init: Initialize ipc API  */
+void apipc_init(void)
+{
+    apipc_init_start(0);
+
+    /* Wait here until Remote CPU init */
+    while(apipc_init_step() != APIPC_RC_SUCCESS)
+    {
+    }
+}
+
+/* apipc_init_start: start a non blocking ipc API initialization */
+void apipc_init_start(uint64_t timeout)
+{
+    /* Initialize peripheral IPC device to a known state */
+    InitIpc();
+
+    /* Build CRC32 kernel tables for checked block transmitions */
+    ipc_crc32_init();
+
+    /* Initializes System IPC driver controller */
+    IPCInitialize(&g_sIpcController1, IPC_INT0, IPC_INT0);
+    IPCInitialize(&g_sIpcController2, IPC_INT1, IPC_INT1);
+
+    init_timeout = timeout;
+    init_timer = ipc_read_timer();
+    init_sm = APIPC_INIT_SM_SRAM_ACCES;
+}
+
+/* apipc_init_step: evolve the ipc API initialization without blocking */
+enum apipc_rc apipc_init_step(void)
+{
+    switch(init_sm)
+    {
+        case APIPC_INIT_SM_UNKNOWN:
+            return APIPC_RC_FAIL;
+
+        case APIPC_INIT_SM_SRAM_ACCES:
+
+            /* Set GSxM blocks property */
+            if(apipc_sram_acces_config() == APIPC_RC_PENDING)
+                break;
+
+            /* Initialize links staging pools, lanes received messages
+             * queues & budgets */
+            apipc_init_links();
+
+            /* initialize the objs array to a known state */
+            apipc_init_objs();
+
+            /* no transaction was committed yet */
+            tx_img.img_sm = APIPC_OBJ_SM_FREE;
+            tx_img.txn = 1;
+            tx_open = 0;
+
+#if !APIPC_POLLED
+            /* Set up IPC interrupts PIEIERx Registers */
+            PieCtrlRegs.PIEIER1.bit.INTx13 = 1; // Set the apropropiate PIEIERx bit for IPC0
+            PieCtrlRegs.PIEIER1.bit.INTx14 = 1; // Set the apropropiate PIEIERx bit for IPC1
+            PieCtrlRegs.PIEIER1.bit.INTx15 = 1; // Set the apropropiate PIEIERx bit for IPC2 mailbox
+#endif
+
+            init_sm = APIPC_INIT_SM_REMOTE_INIT;
+
+        case APIPC_INIT_SM_REMOTE_INIT:
+
+            /* Acknowledge Local CPU start & check Remote CPU init */
+            if(apipc_check_remote_cpu_init() == APIPC_RC_PENDING)
+                break;
+
+            init_sm = APIPC_INIT_SM_DONE;
+
+        case APIPC_INIT_SM_DONE:
+            return APIPC_RC_SUCCESS;
+    }
+
+    if(init_timeout && ipc_timer_expired(init_timer, init_timeout))
+        return APIPC_RC_TIMEOUT;
+
+    return APIPC_RC_PENDING;
+}
+
+/* apipc_init_state: consult the actual state of the initialization sm. */
+enum apipc_init_sm apipc_init_state(void)
+{
+    return init_sm;
+}
+
+/* apipc_register_obj: register data as an apipc obj to be able to be tranfer
+ * between cores */
+enum apipc_rc apipc_register_obj(uint16_t obj_idx, enum apipc_obj_type obj_type,
+                                 void *paddr, size_t size, uint16_t startup)
+{
+    enum apipc_rc rc;
+    struct apipc_obj *plobj;
+
+    rc = APIPC_RC_SUCCESS;
+    plobj = APIPC_LOBJ(obj_idx);
+
+    if(plobj->paddr != NULL)
+        return APIPC_RC_FAIL;
+
+    if(obj_type == APIPC_OBJ_TYPE_INLINE &&
+       (size == 0 || size > APIPC_INLINE_WORDS))
+        return APIPC_RC_FAIL;
+
+    plobj->type = (uint16_t)obj_type;
+    plobj->flags = 0;
+    apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_UNKNOWN;
+    plobj->paddr = paddr;
+    plobj->len = size;
+    apipc_ctl.lane[obj_idx] = APIPC_LANE_AUTO;
+    apipc_ctl.pshadow[obj_idx] = NULL;
+    apipc_ctl.flag[obj_idx].inflight = 0;
+    apipc_ctl.flag[obj_idx].delta = 0;
+    apipc_ctl.flag[obj_idx].shadow = 0;
+    apipc_ctl.flag[obj_idx].stream = 0;
+    apipc_ctl.bits[obj_idx] = 0;
+    apipc_ctl.recover[obj_idx] = 0;
+    apipc_ctl.rx_hook[obj_idx] = NULL;
+    apipc_ctl.psnap[obj_idx] = NULL;
+    apipc_ctl.flag[obj_idx].crc = 0;
+    apipc_ctl.flag[obj_idx].urgent = 0;
+    apipc_ctl.pfresh[obj_idx] = NULL;
+    apipc_ctl.pheld[obj_idx] = NULL;
+    apipc_ctl.lease[obj_idx] = APIPC_LEASE_MAX;
+    apipc_ctl.flag[obj_idx].isr_push = 0;
+    apipc_ctl.isr_req[obj_idx] = APIPC_ISR_NONE;
+
+    if(startup)
+        apipc_ctl.flag[obj_idx].startup = 1;
+    else
+        apipc_ctl.flag[obj_idx].startup = 0;
+
+    return rc;
+}
+
+/* apipc_register_snapshot: register a triple buffered snapshot receiving obj */
+enum apipc_rc apipc_register_snapshot(uint16_t obj_idx, void *pbufs, size_t size)
+{
+    if(obj_idx >= APIPC_MAX_OBJ || pbufs == NULL || size == 0)
+        return APIPC_RC_FAIL;
+
+    if(apipc_register_obj(obj_idx, APIPC_OBJ_TYPE_SNAPSHOT, pbufs, size, 0) != APIPC_RC_SUCCESS)
+        return APIPC_RC_FAIL;
+
+    /* remote writes land on buffer 0, the descriptor always shows back */
+    apipc_ctl.snap[obj_idx] = APIPC_SNAP(0, 1, 2);
+    apipc_ctl.psnap[obj_idx] = (uint16_t *) pbufs;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_snapshot_acquire: take the latest published snapshot */
+const void *apipc_snapshot_acquire(uint16_t obj_idx)
+{
+    uint16_t key;
+    uint16_t s;
+
+    if(obj_idx >= APIPC_MAX_OBJ || apipc_ctl.psnap[obj_idx] == NULL)
+        return NULL;
+
+    key = __disable_interrupts();
+
+    s = apipc_ctl.snap[obj_idx];
+
+    /* swap front & middle only if a newer snapshot was published */
+    if(!(s & APIPC_SNAP_HELD) && (s & APIPC_SNAP_FRESH))
+        s = APIPC_SNAP(APIPC_SNAP_BACK(s), APIPC_SNAP_FRONT(s), APIPC_SNAP_MIDDLE(s));
+
+    apipc_ctl.snap[obj_idx] = s | APIPC_SNAP_HELD;
+
+    __restore_interrupts(key);
+
+    return apipc_ctl.psnap[obj_idx] + APIPC_SNAP_FRONT(s) * APIPC_LOBJ(obj_idx)->len;
+}
+
+/* apipc_snapshot_release: let the next acquire take a newer snapshot */
+enum apipc_rc apipc_snapshot_release(uint16_t obj_idx)
+{
+    uint16_t key;
+
+    if(obj_idx >= APIPC_MAX_OBJ || apipc_ctl.psnap[obj_idx] == NULL)
+        return APIPC_RC_FAIL;
+
+    key = __disable_interrupts();
+    apipc_ctl.snap[obj_idx] &= ~APIPC_SNAP_HELD;
+    __restore_interrupts(key);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_obj_set_lane: assign an obj to a transport lane */
+enum apipc_rc apipc_obj_set_lane(uint16_t obj_idx, enum apipc_lane_id lane)
+{
+    if(obj_idx >= APIPC_MAX_OBJ || lane > APIPC_LANE_AUTO)
+        return APIPC_RC_FAIL;
+
+    apipc_ctl.lane[obj_idx] = lane;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_obj_set_link: bind an obj index to the link of the peer it is
+ * transmitted to */
+enum apipc_rc apipc_obj_set_link(uint16_t obj_idx, uint16_t link)
+{
+    if(obj_idx >= APIPC_MAX_OBJ || link >= APIPC_MAX_LINK ||
+       apipc_links[link].l_obj == NULL)
+        return APIPC_RC_FAIL;
+
+    /* descriptor is already published on the actual link */
+    if(APIPC_LOBJ(obj_idx)->paddr != NULL)
+        return APIPC_RC_FAIL;
+
+    apipc_ctl.link[obj_idx] = link;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_link_register: configure the link to an additional peer */
+enum apipc_rc apipc_link_register(uint16_t link, const struct apipc_link_cfg *pcfg)
+{
+    struct apipc_link *plink;
+    uint16_t lane_idx;
+
+    /* links are configured before apipc is initialized */
+    if(link == APIPC_LINK_0 || link >= APIPC_MAX_LINK || pcfg == NULL ||
+       init_sm != APIPC_INIT_SM_UNKNOWN)
+        return APIPC_RC_FAIL;
+
+    if(pcfg->l_obj == NULL || pcfg->r_obj == NULL || pcfg->pdata == NULL)
+        return APIPC_RC_FAIL;
+
+    plink = &apipc_links[link];
+    plink->l_obj = pcfg->l_obj;
+    plink->r_obj = pcfg->r_obj;
+    plink->pdata = pcfg->pdata;
+    plink->data_len = pcfg->data_len;
+    plink->l_credit = pcfg->l_credit;
+    plink->r_credit = pcfg->r_credit;
+
+    for(lane_idx = 0; lane_idx < APIPC_MAX_LANE; lane_idx++)
+    {
+        plink->lane[lane_idx].pctrl = pcfg->pctrl[lane_idx];
+        plink->lane[lane_idx].irq_flag = pcfg->irq_flag[lane_idx];
+    }
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_link_drain: store the messages received on a link lane */
+void apipc_link_drain(uint16_t link, enum apipc_lane_id lane)
+{
+    if(link >= APIPC_MAX_LINK || lane >= APIPC_MAX_LANE ||
+       apipc_links[link].l_obj == NULL)
+        return;
+
+    apipc_lane_drain(&apipc_links[link].lane[lane]);
+}
+
+/* apipc_obj_set_delta: enable delta transmitions on a block obj */
+enum apipc_rc apipc_obj_set_delta(uint16_t obj_idx, void *pshadow)
+{
+    struct apipc_obj *plobj;
+
+    if(obj_idx >= APIPC_MAX_OBJ)
+        return APIPC_RC_FAIL;
+
+    plobj = APIPC_LOBJ(obj_idx);
+
+    if(plobj->paddr == NULL || plobj->type != APIPC_OBJ_TYPE_BLOCK)
+        return APIPC_RC_FAIL;
+
+    /* streamed blocks are fragmented whole, runs aren't packed per fragment */
+    if(pshadow != NULL && plobj->len > APIPC_STREAM_CHUNK)
+        return APIPC_RC_FAIL;
+
+    /* first delta transmition is always a whole one */
+    apipc_ctl.flag[obj_idx].shadow = 0;
+    apipc_ctl.pshadow[obj_idx] = (uint16_t *) pshadow;
+    apipc_ctl.flag[obj_idx].delta = (pshadow != NULL);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_obj_set_crc: enable CRC32 checked transmitions on a block obj */
+enum apipc_rc apipc_obj_set_crc(uint16_t obj_idx, uint16_t enable)
+{
+    struct apipc_obj *plobj;
+
+    if(obj_idx >= APIPC_MAX_OBJ)
+        return APIPC_RC_FAIL;
+
+    plobj = APIPC_LOBJ(obj_idx);
+
+    if(plobj->paddr == NULL ||
+       (plobj->type != APIPC_OBJ_TYPE_BLOCK && plobj->type != APIPC_OBJ_TYPE_SNAPSHOT))
+        return APIPC_RC_FAIL;
+
+    apipc_ctl.flag[obj_idx].crc = (enable != 0);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_obj_set_urgent: set an obj puts to bypass the interrupt coalescing */
+enum apipc_rc apipc_obj_set_urgent(uint16_t obj_idx, uint16_t enable)
+{
+    if(obj_idx >= APIPC_MAX_OBJ)
+        return APIPC_RC_FAIL;
+
+    apipc_ctl.flag[obj_idx].urgent = (enable != 0);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_stats: copy apipc statistics */
+enum apipc_rc apipc_stats(struct apipc_stats *pstats, uint16_t reset)
+{
+    uint16_t stage_live;
+
+    if(pstats == NULL)
+        return APIPC_RC_FAIL;
+
+    *pstats = stats;
+
+    if(reset)
+    {
+        stage_live = stats.stage_live;
+        memset(&stats, 0, sizeof(stats));
+        stats.stage_live = stage_live;
+        stats.stage_max = stage_live;
+    }
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_probe_send: put a latency probe on a link lane */
+enum apipc_rc apipc_probe_send(uint16_t link, enum apipc_lane_id lane)
+{
+    if(link >= APIPC_MAX_LINK || lane > APIPC_LANE_AUTO ||
+       apipc_links[link].l_obj == NULL || init_sm != APIPC_INIT_SM_DONE)
+        return APIPC_RC_FAIL;
+
+    if(apipc_links[link].probe.busy)
+        return APIPC_RC_BUSY;
+
+    return apipc_probe_put(&apipc_links[link], lane);
+}
+
+/* apipc_probe_monitor: start or stop the periodic probes of a link lane */
+enum apipc_rc apipc_probe_monitor(uint16_t link, enum apipc_lane_id lane,
+                                  uint64_t period)
+{
+    if(link >= APIPC_MAX_LINK || lane > APIPC_LANE_AUTO ||
+       apipc_links[link].l_obj == NULL)
+        return APIPC_RC_FAIL;
+
+    apipc_links[link].probe.lane = lane;
+    apipc_links[link].probe.period = period;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_probe_stats: copy a link latency probe statistics */
+enum apipc_rc apipc_probe_stats(uint16_t link, struct apipc_probe_stats *pstats,
+                                uint16_t reset)
+{
+    if(link >= APIPC_MAX_LINK || pstats == NULL ||
+       apipc_links[link].l_obj == NULL)
+        return APIPC_RC_FAIL;
+
+    *pstats = apipc_links[link].probe.stats;
+
+    if(reset)
+        apipc_probe_reset(&apipc_links[link].probe);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_obj_set_lease: consume an obj block writes in place */
+enum apipc_rc apipc_obj_set_lease(uint16_t obj_idx, uint16_t enable)
+{
+    struct apipc_obj *plobj;
+
+    if(obj_idx >= APIPC_MAX_OBJ)
+        return APIPC_RC_FAIL;
+
+    plobj = APIPC_LOBJ(obj_idx);
+
+    if(plobj->paddr == NULL || plobj->type != APIPC_OBJ_TYPE_BLOCK ||
+       plobj->len > APIPC_STREAM_CHUNK)
+        return APIPC_RC_FAIL;
+
+    if(enable)
+        plobj->flags |= APIPC_OBJ_LEASE;
+    else
+    {
+        plobj->flags &= ~APIPC_OBJ_LEASE;
+
+        /* a block never acquired goes back right away */
+        if(apipc_ctl.pfresh[obj_idx] != NULL)
+        {
+            apipc_lease_return(APIPC_OBJ_LINK(obj_idx), apipc_ctl.pfresh[obj_idx],
+                               apipc_ctl.rx_gen[obj_idx]);
+            apipc_ctl.pfresh[obj_idx] = NULL;
+        }
+    }
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_lease_acquire: take the newest leased block of an obj */
+const void *apipc_lease_acquire(uint16_t obj_idx)
+{
+    if(obj_idx >= APIPC_MAX_OBJ)
+        return NULL;
+
+    if(apipc_ctl.pheld[obj_idx] == NULL)
+    {
+        apipc_ctl.pheld[obj_idx] = apipc_ctl.pfresh[obj_idx];
+        apipc_ctl.held_gen[obj_idx] = apipc_ctl.rx_gen[obj_idx];
+        apipc_ctl.pfresh[obj_idx] = NULL;
+    }
+
+    return apipc_ctl.pheld[obj_idx];
+}
+
+/* apipc_lease_release: give the acquired leased block back */
+enum apipc_rc apipc_lease_release(uint16_t obj_idx)
+{
+    if(obj_idx >= APIPC_MAX_OBJ || apipc_ctl.pheld[obj_idx] == NULL)
+        return APIPC_RC_FAIL;
+
+    apipc_lease_return(APIPC_OBJ_LINK(obj_idx), apipc_ctl.pheld[obj_idx],
+                       apipc_ctl.held_gen[obj_idx]);
+    apipc_ctl.pheld[obj_idx] = NULL;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_send_isr: request an obj transfer from interrupt context */
+enum apipc_rc apipc_send_isr(uint16_t obj_idx)
+{
+    struct apipc_lane *plane;
+    uint16_t key;
+
+    if(obj_idx >= APIPC_MAX_OBJ || APIPC_LOBJ(obj_idx)->paddr == NULL)
+        return APIPC_RC_FAIL;
+
+    key = __disable_interrupts();
+
+    /* idle objs are put right away if the lane takes them */
+    if(apipc_ctl.flag[obj_idx].isr_push && init_sm == APIPC_INIT_SM_DONE &&
+       apipc_ctl.obj_sm[obj_idx] == APIPC_OBJ_SM_IDLE &&
+       APIPC_ROBJ(obj_idx)->paddr != NULL)
+    {
+        plane = apipc_obj_lane(obj_idx);
+
+        /* a single put waits his response, holding a lane slot */
+        if(!apipc_ctl.flag[obj_idx].inflight &&
+           plane->inflight < APIPC_LANE_BUDGET && !apipc_lane_held(plane) &&
+           apipc_put_keyed(plane, obj_idx, APIPC_PUT_URGENT) != STATUS_FAIL)
+        {
+            apipc_ctl.isr_timer[obj_idx] = ipc_read_timer();
+            apipc_ctl.isr_req[obj_idx] = APIPC_ISR_PUT;
+            apipc_ctl.tx_lane[obj_idx] = plane->id;
+            apipc_ctl.flag[obj_idx].inflight = 1;
+            stats.isr_push++;
+
+            apipc_lane_take(plane);
+            __restore_interrupts(key);
+
+            return APIPC_RC_SUCCESS;
+        }
+    }
+
+    /* a put obj is transmitted again once his response arrives */
+    apipc_ctl.isr_req[obj_idx] = APIPC_ISR_REQUESTED;
+
+    __restore_interrupts(key);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_obj_set_isr_push: let apipc_send_isr() put an obj straight away */
+enum apipc_rc apipc_obj_set_isr_push(uint16_t obj_idx, uint16_t enable)
+{
+    struct apipc_obj *plobj;
+
+    if(obj_idx >= APIPC_MAX_OBJ)
+        return APIPC_RC_FAIL;
+
+    plobj = APIPC_LOBJ(obj_idx);
+
+    if(plobj->paddr == NULL ||
+       (plobj->type != APIPC_OBJ_TYPE_DATA && plobj->type != APIPC_OBJ_TYPE_FLAGS))
+        return APIPC_RC_FAIL;
+
+    apipc_ctl.flag[obj_idx].isr_push = (enable != 0);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_isr_proc - start the objs apipc_send_isr() requested and transmit
+ * again the put ones whose response didn't arrive */
+static void apipc_isr_proc(void)
+{
+    uint16_t obj_idx;
+    uint16_t key;
+
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+    {
+        if(apipc_ctl.isr_req[obj_idx] == APIPC_ISR_NONE ||
+           apipc_ctl.obj_sm[obj_idx] != APIPC_OBJ_SM_IDLE)
+            continue;
+
+        key = __disable_interrupts();
+
+        if(apipc_ctl.isr_req[obj_idx] == APIPC_ISR_REQUESTED ||
+           ipc_timer_expired(apipc_ctl.isr_timer[obj_idx], IPC_TIMER_WAIT_5mS))
+        {
+            /* a put still waiting his response gives his lane slot up */
+            apipc_obj_release(obj_idx);
+            apipc_ctl.isr_req[obj_idx] = APIPC_ISR_NONE;
+            apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_INIT;
+        }
+
+        __restore_interrupts(key);
+    }
+}
+
+/* apipc_obj_set_rx_hook: register the hook run when remote data lands */
+enum apipc_rc apipc_obj_set_rx_hook(uint16_t obj_idx, apipc_rx_hook hook)
+{
+    if(obj_idx >= APIPC_MAX_OBJ || APIPC_LOBJ(obj_idx)->paddr == NULL)
+        return APIPC_RC_FAIL;
+
+    apipc_ctl.rx_hook[obj_idx] = hook;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_lane_stats: copy a APIPC_LINK_0 lane statistics */
+enum apipc_rc apipc_lane_stats(enum apipc_lane_id lane,
+                               struct apipc_lane_stats *pstats)
+{
+    return apipc_link_lane_stats(APIPC_LINK_0, lane, pstats);
+}
+
+/* apipc_link_lane_stats: copy a link lane statistics */
+enum apipc_rc apipc_link_lane_stats(uint16_t link, enum apipc_lane_id lane,
+                                    struct apipc_lane_stats *pstats)
+{
+    if(link >= APIPC_MAX_LINK || lane >= APIPC_MAX_LANE || pstats == NULL ||
+       apipc_links[link].l_obj == NULL)
+        return APIPC_RC_FAIL;
+
+    *pstats = apipc_links[link].lane[lane].stats;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_obj_state: consult the actual state of the obj_idx object sm. */
+enum apipc_obj_sm apipc_obj_state(uint16_t obj_idx)
+{
+    return apipc_ctl.obj_sm[obj_idx];
+}
+
+
+/* apipc_send: request transfer an object on demand. */
+ram_func enum apipc_rc apipc_send(uint16_t obj_idx)
+{
+    enum apipc_rc rc;
+    uint16_t key;
+
+    rc = APIPC_RC_SUCCESS;
+
+    /* apipc_send_isr() puts idle objs, the state is checked and set with
+     * interrupts kept out */
+    key = __disable_interrupts();
+
+    if(apipc_ctl.obj_sm[obj_idx] != APIPC_OBJ_SM_IDLE)
+        rc = APIPC_RC_FAIL;
+    else if(apipc_ctl.isr_req[obj_idx] != APIPC_ISR_NONE)
+    {
+        /* a put obj holds his lane slot, apipc_isr_proc() gives it back
+         * before transmitting the obj again */
+        apipc_ctl.isr_req[obj_idx] = APIPC_ISR_REQUESTED;
+    }
+    else
+    {
+        apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_INIT;
+
+        /* obj waits queued until the remote core gives credits back */
+        if(apipc_lane_held(apipc_obj_lane(obj_idx)))
+            rc = APIPC_RC_BUSY;
+    }
+
+    __restore_interrupts(key);
+
+    return rc;
+}
+
+/* apipc_send_now: transfer an object on demand, written right away if his lane
+ * has room */
+ram_func enum apipc_rc apipc_send_now(uint16_t obj_idx)
+{
+    struct apipc_lane *plane;
+    enum apipc_rc rc;
+    uint16_t key;
+
+    if(obj_idx >= APIPC_MAX_OBJ || apipc_ctl.obj_sm[obj_idx] != APIPC_OBJ_SM_IDLE)
+        return APIPC_RC_FAIL;
+
+    key = __disable_interrupts();
+
+    plane = apipc_obj_lane(obj_idx);
+
+    /* lane is loaded or apipc_send_isr() put the obj, the obj sm transmits
+     * it on the next apipc_app() */
+    if(plane->inflight >= APIPC_LANE_BUDGET || apipc_lane_held(plane) ||
+       IpcPutFree(plane->pctrl) == 0 ||
+       apipc_ctl.isr_req[obj_idx] != APIPC_ISR_NONE)
+    {
+        rc = (apipc_send(obj_idx) == APIPC_RC_SUCCESS) ? APIPC_RC_PENDING :
+                                                         APIPC_RC_BUSY;
+        __restore_interrupts(key);
+
+        return rc;
+    }
+
+    /* run the obj sm INIT and WRITING states from here, out of
+     * apipc_send_isr() reach once it left IDLE */
+    apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_INIT;
+
+    __restore_interrupts(key);
+
+    apipc_proc_obj(obj_idx);
+
+    if(apipc_ctl.obj_sm[obj_idx] != APIPC_OBJ_SM_WAITTING_RESPONSE)
+        return APIPC_RC_PENDING;
+
+    stats.tx_now++;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_flags_set_bits: Sets the designated bits at the remote CPU obj */
+enum apipc_rc apipc_flags_set_bits(uint16_t obj_idx, uint32_t bmask)
+{
+    return apipc_flags_bits(obj_idx, IPC_SET_BITS, bmask);
+}
+
+/* apipc_flags_clear_bits: Clear the designated bits at the remote CPU obj */
+enum apipc_rc apipc_flags_clear_bits(uint16_t obj_idx, uint32_t bmask)
+{
+    return apipc_flags_bits(obj_idx, IPC_CLEAR_BITS, bmask);
+}
+
+/* apipc_flags_bits: put a set or clear bits command, it holds a lane slot
+ * until its response is received */
+static enum apipc_rc apipc_flags_bits(uint16_t obj_idx, uint32_t ulCommand,
+                                      uint32_t bmask)
+{
+    struct apipc_obj *plobj;
+    struct apipc_obj *probj;
+    struct apipc_lane *plane;
+
+    plobj = APIPC_LOBJ(obj_idx);
+    probj = APIPC_ROBJ(obj_idx);
+
+    plane = apipc_obj_lane(obj_idx);
+
+    if(plane->inflight >= APIPC_LANE_BUDGET)
+        return APIPC_RC_BUSY;
+
+    if(apipc_lane_held(plane))
+    {
+        plane->stats.tx_held++;
+        return APIPC_RC_BUSY;
+    }
+
+    if(STATUS_FAIL == apipc_put(plane, ulCommand, (uint32_t)(uintptr_t)probj->paddr,
+                                (uint32_t)(uint16_t)plobj->len, bmask,
+                                APIPC_OBJ_PUT_MODE(obj_idx)))
+    {
+        plane->stats.tx_fail++;
+        return APIPC_RC_FAIL;
+    }
+
+    apipc_ctl.tx_lane[obj_idx] = plane->id;
+    apipc_ctl.bits[obj_idx]++;
+    apipc_ctl.bits_timer[obj_idx] = ipc_read_timer();
+    plane->stats.tx_cmd++;
+
+    apipc_lane_take(plane);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_write: to transmit a value to the remote core apipc interacts with the
+ * ipc driver according to the obj type */
+static enum apipc_rc apipc_write(uint16_t obj_idx)
+{
+    enum apipc_rc rc;
+
+    struct apipc_obj *plobj;
+    struct apipc_obj *probj;
+    struct apipc_lane *plane;
+
+    uint32_t ulData;
+    uint16_t usWords[APIPC_INLINE_WORDS];
+    uint16_t usSlot;
+
+    /* initialize local variables */
+    rc = APIPC_RC_SUCCESS;
+    plobj = APIPC_LOBJ(obj_idx);
+    probj = APIPC_ROBJ(obj_idx);
+    plane = apipc_obj_lane(obj_idx);
+
+    /* Check that l & r objects were initialized */
+    if( (probj->paddr == NULL) || (plobj->paddr == NULL) )
+        return APIPC_RC_FAIL;
+
+    /* remote snapshots move their descriptor once a write is published, so
+     * the destination is latched to match the responses */
+    apipc_ctl.pdst[obj_idx] = (uint16_t *) probj->paddr;
+
+        /* request ipc api write according to the obj type */
+    switch(plobj->type)
+    {
+        case APIPC_OBJ_TYPE_SNAPSHOT:
+        case APIPC_OBJ_TYPE_BLOCK:
+
+            /* blocks larger than a chunk are streamed in fragments, every
+             * fragment holds his own lane slot */
+            if(plobj->len > APIPC_STREAM_CHUNK)
+            {
+                apipc_ctl.tx_lane[obj_idx] = plane->id;
+                return apipc_stream_start(obj_idx, plane);
+            }
+
+            /* transmit only changed word runs if they aren't dense, a split
+             * whole block staging is always completed */
+            if(apipc_ctl.pGSxM[obj_idx] == NULL && !apipc_ctl.flag[obj_idx].crc &&
+               apipc_ctl.flag[obj_idx].delta && apipc_ctl.flag[obj_idx].shadow &&
+               (ulData = apipc_delta_size(obj_idx)) <= APIPC_DELTA_DENSE(plobj->len))
+            {
+                /* nothing changed since the last transmition, the remote
+                 * block holds it already and the obj completes here */
+                if(ulData == 0)
+                {
+                    apipc_obj_done(obj_idx);
+                    return APIPC_RC_PENDING;
+                }
+
+                apipc_ctl.pGSxM[obj_idx] = (uint16_t *) apipc_stage_alloc(APIPC_OBJ_LINK(obj_idx), (size_t)ulData);
+
+                if(apipc_ctl.pGSxM[obj_idx] == NULL)
+                {
+                    rc = APIPC_RC_FAIL;
+                    break; 
+                }
+
+                /* block changed while packed, next retry transmits it whole */
+                if(apipc_delta_pack(obj_idx, apipc_ctl.pGSxM[obj_idx], (uint16_t)ulData) != ulData)
+                {
+                    apipc_stage_free(apipc_ctl.pGSxM[obj_idx]);
+                    apipc_ctl.pGSxM[obj_idx] = NULL;
+                    rc = APIPC_RC_FAIL;
+                    break;
+                }
+
+                /* request ipc driver write */
+                if(STATUS_FAIL == apipc_put(plane, (uint32_t) APIPC_DELTA_WRITE,
+                                            (uint32_t)(uintptr_t) probj->paddr,
+                                            (uint32_t)(uintptr_t) apipc_ctl.pGSxM[obj_idx],
+                                            ulData, APIPC_OBJ_PUT_MODE(obj_idx)))
+                {
+                    /* the packed runs aren't a block, the retry packs them
+                     * again or stages the whole block */
+                    plane->stats.tx_fail++;
+                    apipc_obj_release(obj_idx);
+                    rc = APIPC_RC_FAIL;
+                }
+                break;
+            }
+
+            /* Allocates spaces for a block on the statically reserved mem
+             * space, unless a split staging copy is being resumed */
+            if(apipc_ctl.pGSxM[obj_idx] == NULL)
+            {
+                /* checked blocks carry their CRC32 after the data */
+                apipc_ctl.pGSxM[obj_idx] = (uint16_t *) apipc_stage_alloc(APIPC_OBJ_LINK(obj_idx),
+                                                                     plobj->len + (apipc_ctl.flag[obj_idx].crc ? 2 : 0));
+                apipc_ctl.staged[obj_idx] = 0;
+                apipc_ctl.crc[obj_idx] = IPC_CRC32_INIT;
+            }
+
+            if(apipc_ctl.pGSxM[obj_idx] == NULL)
+            {
+                rc = APIPC_RC_FAIL;
+                break; 
+            }
+
+            /* Place data to be writen in shared memory */
+            if(apipc_stage(obj_idx) == APIPC_RC_PENDING)
+            {
+                rc = APIPC_RC_PENDING;
+                break;
+            }
+
+            if(apipc_ctl.flag[obj_idx].crc && apipc_ctl.lease[obj_idx] == APIPC_LEASE_MAX)
+            {
+                apipc_ctl.pGSxM[obj_idx][plobj->len] = (uint16_t) ~apipc_ctl.crc[obj_idx];
+                apipc_ctl.pGSxM[obj_idx][plobj->len + 1] = (uint16_t) (~apipc_ctl.crc[obj_idx] >> 16);
+
+                ulData = apipc_put(plane, (uint32_t) APIPC_CRC_WRITE,
+                                   (uint32_t)(uintptr_t) probj->paddr,
+                                   (uint32_t)(uintptr_t) apipc_ctl.pGSxM[obj_idx],
+                                   plobj->len, APIPC_OBJ_PUT_MODE(obj_idx));
+            }
+            else if((usSlot = apipc_ctl.lease[obj_idx]) < APIPC_LEASE_MAX ||
+                    (plobj->type == APIPC_OBJ_TYPE_BLOCK &&
+                     (probj->flags & APIPC_OBJ_LEASE) && !apipc_ctl.flag[obj_idx].delta &&
+                     (usSlot = apipc_lease_slot(APIPC_OBJ_LINK(obj_idx))) < APIPC_LEASE_MAX))
+            {
+                /* remote core reads the staging in place, it is freed once
+                 * his lease is released. A retransmition puts the lent one
+                 * again on the same generation, the remote core may hold it
+                 * already */
+                if(apipc_ctl.lease[obj_idx] == APIPC_LEASE_MAX)
+                    APIPC_OBJ_LINK(obj_idx)->lent_gen[usSlot] = ++apipc_ctl.gen[obj_idx];
+
+                ulData = apipc_put(plane, APIPC_LEASE_WRITE,
+                                   (uint32_t)(uintptr_t)probj->paddr,
+                                   APIPC_LEASE_W1(APIPC_OBJ_LINK(obj_idx)->lent_gen[usSlot],
+                                                  plobj->len),
+                                   (uint32_t)(uintptr_t)apipc_ctl.pGSxM[obj_idx],
+                                   APIPC_OBJ_PUT_MODE(obj_idx));
+
+                if(STATUS_FAIL != ulData)
+                {
+                    APIPC_OBJ_LINK(obj_idx)->lent[usSlot] = apipc_ctl.pGSxM[obj_idx];
+                    apipc_ctl.lease[obj_idx] = usSlot;
+                }
+            }
+            else
+                /* request ipc driver write */
+                ulData = apipc_put(plane, IPC_BLOCK_WRITE,
+                                   (uint32_t)(uintptr_t)probj->paddr,
+                                   ((uint32_t)IPC_LENGTH_16_BITS << 16) |
+                                   (uint16_t)plobj->len,
+                                   (uint32_t)(uintptr_t)apipc_ctl.pGSxM[obj_idx],
+                                   APIPC_OBJ_PUT_MODE(obj_idx));
+
+            if(STATUS_FAIL == ulData)
+            {
+                plane->stats.tx_fail++;
+                apipc_obj_release(obj_idx);
+                rc = APIPC_RC_FAIL;
+                break;
+            }
+
+            /* keep the transmitted image to pack the next delta */
+            if(apipc_ctl.flag[obj_idx].delta)
+            {
+                u16memcpy(apipc_ctl.pshadow[obj_idx], apipc_ctl.pGSxM[obj_idx], plobj->len);
+                apipc_ctl.flag[obj_idx].shadow = 1;
+            }
+            break;
+
+        case APIPC_OBJ_TYPE_DATA:
+        case APIPC_OBJ_TYPE_FLAGS:
+
+            /* request ipc driver write */
+            if(STATUS_FAIL == apipc_put_keyed(plane, obj_idx,
+                                              APIPC_OBJ_PUT_MODE(obj_idx)))
+            {
+                plane->stats.tx_fail++;
+                rc = APIPC_RC_FAIL;
+            }
+            break;
+
+        case APIPC_OBJ_TYPE_INLINE:
+
+            /* pack the obj words, unused ones travel as 0 */
+            memset(usWords, 0, sizeof(usWords));
+            u16memcpy(usWords, plobj->paddr, plobj->len);
+
+            /* request ipc driver write */
+            if(STATUS_FAIL == apipc_put(plane, APIPC_INLINE_WRITE,
+                                        (uint32_t)(uintptr_t)probj->paddr,
+                                        (uint32_t)usWords[0] | ((uint32_t)usWords[1] << 16),
+                                        (uint32_t)usWords[2] | ((uint32_t)usWords[3] << 16),
+                                        APIPC_OBJ_PUT_MODE(obj_idx)))
+            {
+                plane->stats.tx_fail++;
+                rc = APIPC_RC_FAIL;
+            }
+            break;
+
+        case APIPC_OBJ_TYPE_FUNC_CALL:
+
+            /* retrieve function obj type argument */
+            ulData = (uint32_t) apipc_ctl.payload[obj_idx];
+
+            /* request ipc driver write */
+            if(STATUS_FAIL == apipc_put(plane, IPC_FUNC_CALL,
+                                        (uint32_t)(uintptr_t)probj->paddr, ulData, 0,
+                                        APIPC_OBJ_PUT_MODE(obj_idx)))
+            {
+                plane->stats.tx_fail++;
+                rc = APIPC_RC_FAIL;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    /* nothing was put, obj should try again later */
+    if(rc == APIPC_RC_PENDING)
+        return rc;
+
+    /* shadow can no longer be trusted to pack the next delta */
+    if(rc == APIPC_RC_FAIL)
+    {
+        apipc_ctl.flag[obj_idx].shadow = 0;
+        return rc;
+    }
+
+    /* obj holds a lane slot until its response is received */
+    apipc_ctl.tx_lane[obj_idx] = plane->id;
+    apipc_ctl.flag[obj_idx].inflight = 1;
+    plane->stats.tx_cmd++;
+
+    apipc_lane_take(plane);
+
+    return rc;
+}
+
+/* apipc_budget_expired - check the apipc_app_budgeted() budget */
+static uint16_t apipc_budget_expired(void)
+{
+    return app_budget && ipc_timer_expired(app_budget_timer, app_budget);
+}
+
+/* apipc_stage - copy a block on his staging space. The copy is split on
+ * APIPC_STAGE_CHUNK words steps and paused once the budget is used up. A
+ * resumed copy whose block changed meanwhile is copied again whole */
+static enum apipc_rc apipc_stage(uint16_t obj_idx)
+{
+    struct apipc_obj *plobj;
+    uint32_t start;
+    uint32_t len;
+    uint16_t split;
+
+    plobj = APIPC_LOBJ(obj_idx);
+    start = apipc_ctl.staged[obj_idx];
+    split = (app_budget != 0);
+
+    while(apipc_ctl.staged[obj_idx] < plobj->len)
+    {
+        len = plobj->len - apipc_ctl.staged[obj_idx];
+
+        if(split && len > APIPC_STAGE_CHUNK)
+            len = APIPC_STAGE_CHUNK;
+
+        /* checked blocks get their CRC32 on the same copy pass */
+        if(apipc_ctl.flag[obj_idx].crc)
+            apipc_ctl.crc[obj_idx] = ipc_crc32_copy(apipc_ctl.pGSxM[obj_idx] + apipc_ctl.staged[obj_idx],
+                                                    (uint16_t *)plobj->paddr + apipc_ctl.staged[obj_idx],
+                                                    len, apipc_ctl.crc[obj_idx]);
+        else
+            u16memcpy(apipc_ctl.pGSxM[obj_idx] + apipc_ctl.staged[obj_idx],
+                      (uint16_t *)plobj->paddr + apipc_ctl.staged[obj_idx], len);
+
+        apipc_ctl.staged[obj_idx] += len;
+
+        if(apipc_ctl.staged[obj_idx] < plobj->len && split && apipc_budget_expired())
+            return APIPC_RC_PENDING;
+
+        /* words copied on former calls must still match, otherwise the remote
+         * core would get old and new words mixed. The block is copied again
+         * whole, overrunning the budget by one block copy */
+        if(apipc_ctl.staged[obj_idx] == plobj->len && start &&
+           start < plobj->len)
+        {
+            for(len = 0; len < start; len++)
+                if(apipc_ctl.pGSxM[obj_idx][len] != ((uint16_t *)plobj->paddr)[len])
+                    break;
+
+            if(len < start)
+            {
+                apipc_ctl.staged[obj_idx] = 0;
+                apipc_ctl.crc[obj_idx] = IPC_CRC32_INIT;
+                split = 0;
+                stats.stage_restart++;
+            }
+
+            start = 0;
+        }
+    }
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_proc_obj - apipc obj state machine process */
+static void apipc_proc_obj(uint16_t obj_idx)
+{
+    enum apipc_rc rc;
+    struct apipc_lane *plane;
+
+    /* set & clear bits commands the remote core never answered give their
+     * lane slots back */
+    if(apipc_ctl.bits[obj_idx] &&
+       ipc_timer_expired(apipc_ctl.bits_timer[obj_idx], IPC_TIMER_WAIT_5mS))
+    {
+        plane = &APIPC_OBJ_LINK(obj_idx)->lane[apipc_ctl.tx_lane[obj_idx]];
+        plane->stats.timeout++;
+        apipc_lane_give(plane, apipc_ctl.bits[obj_idx]);
+        apipc_ctl.bits[obj_idx] = 0;
+    }
+
+    switch(apipc_ctl.obj_sm[obj_idx])
+    {
+        case APIPC_OBJ_SM_UNKNOWN:
+            if(APIPC_LOBJ(obj_idx)->paddr == NULL)
+            {
+                apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_FREE;
+                break;
+            }
+            if(!apipc_ctl.flag[obj_idx].startup)
+            {
+                apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_IDLE;
+                break;
+            }
+
+        /* obj transmition process starst here */
+        case APIPC_OBJ_SM_INIT:
+        /* 
+         * Every obj transmit process starts through this state.
+         */
+                apipc_ctl.retry[obj_idx] = 3;
+                apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_WRITING;
+
+        case APIPC_OBJ_SM_WRITING:
+
+            plane = apipc_obj_lane(obj_idx);
+
+            /* wait here until the lane has budget for one more command */
+            if(plane->inflight >= APIPC_LANE_BUDGET)
+                break;
+
+            /* and the remote queue credits for it */
+            if(apipc_lane_held(plane))
+            {
+                plane->stats.tx_held++;
+                break;
+            }
+
+            rc = apipc_write(obj_idx);
+
+            /* wait here until a stream is released or a staging copy is
+             * resumed, an unchanged delta obj already went idle */
+            if(rc == APIPC_RC_PENDING)
+                break;
+
+            if(rc == APIPC_RC_SUCCESS)
+            {
+                apipc_ctl.timer[obj_idx] = ipc_read_timer();
+                apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_WAITTING_RESPONSE;
+            }
+            else
+                apipc_obj_retry(obj_idx);
+            break;
+
+        case APIPC_OBJ_SM_WAITTING_RESPONSE:
+
+            if(ipc_timer_expired(apipc_ctl.timer[obj_idx], IPC_TIMER_WAIT_5mS))
+            {
+                APIPC_OBJ_LINK(obj_idx)->lane[apipc_ctl.tx_lane[obj_idx]].stats.timeout++;
+                apipc_obj_release(obj_idx);
+
+                /* remote block state is unknown, next transmition is whole */
+                apipc_ctl.flag[obj_idx].shadow = 0;
+
+                apipc_obj_retry(obj_idx);
+            }
+            break;
+
+        case APIPC_OBJ_SM_RETRY:
+
+            if(ipc_timer_expired(apipc_ctl.timer[obj_idx], IPC_TIMER_WAIT_5mS))
+            {
+                apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_WRITING;
+            }
+            break;
+
+        case APIPC_OBJ_SM_FAIL:
+            if(!apipc_ctl.flag[obj_idx].startup)
+                apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_IDLE;
+            break;
+
+            /* obj is started and idle ready to transmit */
+        case APIPC_OBJ_SM_IDLE:
+            break;
+            /* obj is free, do nothing */
+        case APIPC_OBJ_SM_FREE:
+            break;
+    }
+}
+
+/* apipc_stream_start - take a free stream and put the first fragments */
+static enum apipc_rc apipc_stream_start(uint16_t obj_idx,
+                                        struct apipc_lane *plane)
+{
+    struct apipc_stream *pstream;
+    uint16_t stream_idx;
+
+    pstream = streams;
+
+    for(stream_idx = 0; stream_idx < APIPC_MAX_STREAM; stream_idx++, pstream++)
+        if(pstream->obj_idx == APIPC_MAX_OBJ)
+            break;
+
+    if(stream_idx == APIPC_MAX_STREAM)
+        return APIPC_RC_PENDING;
+
+    pstream->obj_idx = obj_idx;
+    pstream->plane = plane;
+    pstream->next = 0;
+    pstream->acked = 0;
+    apipc_ctl.flag[obj_idx].stream = 1;
+
+    if(apipc_stream_fill(pstream) == 0)
+    {
+        apipc_stream_release(obj_idx);
+        return APIPC_RC_FAIL;
+    }
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_stream_fill - put fragments while the window has room. Returns the
+ * number of fragments put */
+static uint16_t apipc_stream_fill(struct apipc_stream *pstream)
+{
+    struct apipc_obj *plobj;
+    struct apipc_frag *pfrag;
+    uint16_t *pdst;
+    uint16_t frag_idx;
+    uint16_t nput;
+    uint32_t len;
+
+    plobj = APIPC_LOBJ(pstream->obj_idx);
+    pdst = apipc_ctl.pdst[pstream->obj_idx];
+    pfrag = pstream->frag;
+    nput = 0;
+
+    for(frag_idx = 0; frag_idx < APIPC_STREAM_WINDOW; frag_idx++, pfrag++)
+    {
+        if(pstream->next >= plobj->len)
+            break;
+
+        /* the window is refilled on the next budgeted call */
+        if(nput && apipc_budget_expired())
+            break;
+
+        if(pfrag->pGSxM != NULL)
+            continue;
+
+        /* lane budget is exhausted, window is refilled later */
+        if(pstream->plane->inflight >= APIPC_LANE_BUDGET)
+            break;
+
+        /* remote queue is out of credits, window is refilled later */
+        if(apipc_lane_held(pstream->plane))
+        {
+            pstream->plane->stats.tx_held++;
+            break;
+        }
+
+        len = plobj->len - pstream->next;
+
+        if(len > APIPC_STREAM_CHUNK)
+            len = APIPC_STREAM_CHUNK;
+
+        /* staging is exhausted, window is refilled later */
+        pfrag->pGSxM = (uint16_t *) apipc_stage_alloc(pstream->plane->plink, (size_t)len);
+
+        if(pfrag->pGSxM == NULL)
+            break;
+
+        u16memcpy(pfrag->pGSxM, (uint16_t *)plobj->paddr + pstream->next, len);
+
+        /* request ipc driver write, fragment lands in place on remote block */
+        if(STATUS_FAIL == apipc_put(pstream->plane, IPC_BLOCK_WRITE,
+                                    (uint32_t)(uintptr_t)(pdst + pstream->next),
+                                    ((uint32_t)IPC_LENGTH_16_BITS << 16) |
+                                    (uint16_t)len,
+                                    (uint32_t)(uintptr_t)pfrag->pGSxM, APIPC_PUT_CMD))
+        {
+            pstream->plane->stats.tx_fail++;
+            apipc_stage_free(pfrag->pGSxM);
+            pfrag->pGSxM = NULL;
+            break;
+        }
+
+        pfrag->offset = pstream->next;
+        pfrag->len = (uint16_t)len;
+        pstream->next += len;
+        pstream->plane->stats.tx_cmd++;
+        nput++;
+
+        apipc_lane_take(pstream->plane);
+    }
+
+    return nput;
+}
+
+/* apipc_stream_release - free the stream owned by an obj and his fragments */
+static void apipc_stream_release(uint16_t obj_idx)
+{
+    struct apipc_stream *pstream;
+    struct apipc_frag *pfrag;
+    uint16_t stream_idx;
+    uint16_t frag_idx;
+
+    pstream = streams;
+
+    for(stream_idx = 0; stream_idx < APIPC_MAX_STREAM; stream_idx++, pstream++)
+    {
+        if(pstream->obj_idx != obj_idx)
+            continue;
+
+        pfrag = pstream->frag;
+
+        for(frag_idx = 0; frag_idx < APIPC_STREAM_WINDOW; frag_idx++, pfrag++)
+            if(pfrag->pGSxM != NULL)
+            {
+                apipc_stage_free(pfrag->pGSxM);
+                pfrag->pGSxM = NULL;
+                apipc_lane_give(pstream->plane, 1);
+            }
+
+        pstream->obj_idx = APIPC_MAX_OBJ;
+    }
+
+    apipc_ctl.flag[obj_idx].stream = 0;
+}
+
+/* apipc_stream_response - take actions over a fragment response. Returns
+ * APIPC_RC_FAIL if the response doesn't belong to any stream */
+static enum apipc_rc apipc_stream_response(tIpcMessage *psMessage)
+{
+    struct apipc_stream *pstream;
+    struct apipc_frag *pfrag;
+    uint16_t stream_idx;
+    uint16_t frag_idx;
+    uint16_t obj_idx;
+
+    pstream = streams;
+
+    for(stream_idx = 0; stream_idx < APIPC_MAX_STREAM; stream_idx++, pstream++)
+    {
+        if(pstream->obj_idx == APIPC_MAX_OBJ)
+            continue;
+
+        obj_idx = pstream->obj_idx;
+        pfrag = pstream->frag;
+
+        /* responses echo the fragment staging address */
+        for(frag_idx = 0; frag_idx < APIPC_STREAM_WINDOW; frag_idx++, pfrag++)
+            if(pfrag->pGSxM != NULL &&
+               (uint32_t)(uintptr_t)pfrag->pGSxM == psMessage->uldataw2 &&
+               (uint32_t)(uintptr_t)(apipc_ctl.pdst[obj_idx] + pfrag->offset) == psMessage->uladdress)
+                break;
+
+        if(frag_idx == APIPC_STREAM_WINDOW)
+            continue;
+
+        apipc_stage_free(pfrag->pGSxM);
+        pfrag->pGSxM = NULL;
+        apipc_lane_give(pstream->plane, 1);
+        pstream->acked += pfrag->len;
+
+        /* every fragment acknowledged, obj transmition is complete */
+        if(pstream->acked >= APIPC_LOBJ(obj_idx)->len)
+        {
+            apipc_obj_release(obj_idx);
+
+            if(apipc_ctl.obj_sm[obj_idx] == APIPC_OBJ_SM_WAITTING_RESPONSE)
+                apipc_obj_done(obj_idx);
+        }
+        else
+            apipc_ctl.timer[obj_idx] = ipc_read_timer();
+
+        return APIPC_RC_SUCCESS;
+    }
+
+    return APIPC_RC_FAIL;
+}
+
+/* apipc_stream_proc - keep every stream window full */
+static void apipc_stream_proc(void)
+{
+    struct apipc_stream *pstream;
+    uint16_t stream_idx;
+
+    pstream = streams;
+
+    for(stream_idx = 0; stream_idx < APIPC_MAX_STREAM; stream_idx++, pstream++)
+        if(pstream->obj_idx != APIPC_MAX_OBJ &&
+           apipc_ctl.obj_sm[pstream->obj_idx] == APIPC_OBJ_SM_WAITTING_RESPONSE)
+            apipc_stream_fill(pstream);
+}
+
+/* apipc_delta_size - count the words the changed runs of a block pack to */
+static uint16_t apipc_delta_size(uint16_t obj_idx)
+{
+    struct apipc_obj *plobj;
+    uint16_t *pcur;
+    uint16_t *pshadow;
+    uint16_t idx;
+    uint16_t gap;
+    uint16_t run;
+    uint16_t size;
+
+    plobj = APIPC_LOBJ(obj_idx);
+    pcur = (uint16_t *) plobj->paddr;
+    pshadow = apipc_ctl.pshadow[obj_idx];
+    size = 0;
+    run = 0;
+    gap = 0;
+
+    for(idx = 0; idx < plobj->len; idx++)
+    {
+        if(pcur[idx] != pshadow[idx])
+        {
+            /* a new run costs his header, a gap is swallowed */
+            if(!run)
+                size += 2;
+            else
+                size += gap;
+
+            size++;
+            run = 1;
+            gap = 0;
+        }
+        else if(run && ++gap > APIPC_DELTA_MERGE_GAP)
+        {
+            run = 0;
+            gap = 0;
+        }
+    }
+
+    return size;
+}
+
+/* apipc_delta_pack - pack the changed runs of a block as [offset, len, data]
+ * words and bring the shadow up to date. Returns the packed length */
+static uint16_t apipc_delta_pack(uint16_t obj_idx, uint16_t *pdst,
+                                 uint16_t size)
+{
+    struct apipc_obj *plobj;
+    uint16_t *pcur;
+    uint16_t *pshadow;
+    uint16_t *prun;
+    uint16_t idx;
+    uint16_t end;
+    uint16_t gap;
+    uint16_t len;
+
+    plobj = APIPC_LOBJ(obj_idx);
+    pcur = (uint16_t *) plobj->paddr;
+    pshadow = apipc_ctl.pshadow[obj_idx];
+    len = 0;
+
+    for(idx = 0; idx < plobj->len; idx++)
+    {
+        if(pcur[idx] == pshadow[idx])
+            continue;
+
+        /* run lasts until more than APIPC_DELTA_MERGE_GAP equal words */
+        for(end = idx + 1, gap = 0; end < plobj->len; end++)
+        {
+            if(pcur[end] != pshadow[end])
+                gap = 0;
+            else if(++gap > APIPC_DELTA_MERGE_GAP)
+                break;
+        }
+        end -= gap;
+
+        if(len + 2 + (end - idx) > size)
+            return 0xFFFF;
+
+        prun = pdst + len;
+        *prun++ = idx;
+        *prun++ = end - idx;
+        len += 2 + (end - idx);
+
+        for(; idx < end; idx++)
+            *prun++ = pshadow[idx] = pcur[idx];
+    }
+
+    return len;
+}
+
+/* apipc_crc_apply - commit a checked block once his CRC32 matches */
+static enum apipc_rc apipc_crc_apply(tIpcMessage *psMessage)
+{
+    uint16_t *pdata;
+    uint32_t len;
+    uint32_t crc;
+
+    pdata = (uint16_t *)(uintptr_t) psMessage->uldataw1;
+    len = psMessage->uldataw2;
+
+    crc = ~ipc_crc32(IPC_CRC32_INIT, pdata, (size_t)len);
+
+    if((uint16_t)crc != pdata[len] || (uint16_t)(crc >> 16) != pdata[len + 1])
+    {
+        stats.crc_fail++;
+        return APIPC_RC_FAIL;
+    }
+
+    u16memcpy((void *)(uintptr_t) psMessage->uladdress, pdata, (size_t)len);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_delta_apply - patch a local block with the runs packed by the remote
+ * core */
+static void apipc_delta_apply(struct apipc_link *plink, tIpcMessage *psMessage)
+{
+    struct apipc_obj *plobj;
+    uint16_t *pdata;
+    uint16_t *pend;
+    uint16_t obj_idx;
+    uint16_t offset;
+    uint16_t len;
+
+    plobj = plink->l_obj;
+
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++, plobj++)
+        if(plobj->paddr != NULL && plobj->paddr == (void *)(uintptr_t) psMessage->uladdress)
+            break;
+
+    if(obj_idx == APIPC_MAX_OBJ)
+        return;
+
+    pdata = (uint16_t *)(uintptr_t) psMessage->uldataw1;
+    pend = pdata + (uint16_t) psMessage->uldataw2;
+
+    while(pdata + 2 <= pend)
+    {
+        offset = *pdata++;
+        len = *pdata++;
+
+        /* a malformed delta is applied up to the last consistent run */
+        if(pdata + len > pend || (uint32_t)offset + len > plobj->len)
+            break;
+
+        u16memcpy((uint16_t *) plobj->paddr + offset, pdata, len);
+        pdata += len;
+    }
+}
+
+/* apipc_image_build - serialize the image member objs on the APIPC_LINK_0
+ * pool. Only APIPC_LINK_0 objs are members. Returns APIPC_RC_BUSY if the pool
+ * has no space now, APIPC_RC_FAIL if the image has no objs or never fits */
+static enum apipc_rc apipc_image_build(struct apipc_image *pimg)
+{
+    struct apipc_link *plink;
+    struct apipc_obj *plobj;
+    uint16_t obj_idx;
+    uint16_t *pdata;
+    uint32_t len;
+
+    plink = &apipc_links[APIPC_LINK_0];
+    pimg->nobj = 0;
+    len = 0;
+    plobj = plink->l_obj;
+
+    /* every obj takes his idx, his len and his data words */
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++, plobj++)
+    {
+        if(!APIPC_IMAGE_MEMBER(pimg, obj_idx))
+            continue;
+
+        len += 2 + plobj->len;
+        pimg->nobj++;
+    }
+
+    if(pimg->nobj == 0 || len > plink->data_len)
+        return APIPC_RC_FAIL;
+
+    pimg->pGSxM = (uint16_t *) apipc_stage_alloc(plink, (size_t)len);
+
+    if(pimg->pGSxM == NULL)
+        return APIPC_RC_BUSY;
+
+    pimg->len = (uint16_t)len;
+    pdata = pimg->pGSxM;
+    plobj = plink->l_obj;
+
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++, plobj++)
+    {
+        if(!APIPC_IMAGE_MEMBER(pimg, obj_idx))
+            continue;
+
+        *pdata++ = obj_idx;
+        *pdata++ = (uint16_t)plobj->len;
+        u16memcpy(pdata, plobj->paddr, plobj->len);
+        pdata += plobj->len;
+    }
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_image_release - give back the image staging memory and lane slot,
+ * once the image is done or failed */
+static void apipc_image_release(struct apipc_image *pimg)
+{
+    apipc_image_unslot(pimg);
+
+    if(pimg->pGSxM)
+    {
+        apipc_stage_free(pimg->pGSxM);
+        pimg->pGSxM = NULL;
+    }
+}
+
+/* apipc_image_unslot - give back only the image lane slot, the built image is
+ * kept to be put again */
+static void apipc_image_unslot(struct apipc_image *pimg)
+{
+    if(pimg->inflight)
+    {
+        apipc_lane_give(&apipc_links[APIPC_LINK_0].lane[pimg->tx_lane], 1);
+        pimg->inflight = 0;
+    }
+}
+
+/* apipc_image_retry - put the kept image again later, or give it up once the
+ * retries are over */
+static void apipc_image_retry(struct apipc_image *pimg)
+{
+    if(pimg->retry)
+    {
+        pimg->timer = ipc_read_timer();
+        pimg->retry--;
+        pimg->img_sm = APIPC_OBJ_SM_RETRY;
+        return;
+    }
+
+    apipc_image_release(pimg);
+    pimg->img_sm = APIPC_OBJ_SM_FAIL;
+}
+
+/* apipc_image_proc - apipc image state machine process */
+static void apipc_image_proc(struct apipc_image *pimg)
+{
+    struct apipc_lane *plane;
+
+    switch(pimg->img_sm)
+    {
+        case APIPC_OBJ_SM_UNKNOWN:
+        case APIPC_OBJ_SM_INIT:
+            pimg->retry = 3;
+            pimg->img_sm = APIPC_OBJ_SM_WRITING;
+
+        case APIPC_OBJ_SM_WRITING:
+
+            plane = apipc_lane_pick(&apipc_links[APIPC_LINK_0], APIPC_LANE_AUTO);
+
+            /* wait here until the lane has budget & credits for one more
+             * command */
+            if(plane->inflight >= APIPC_LANE_BUDGET || apipc_lane_held(plane))
+                break;
+
+            /* a committed transaction comes already built */
+            if(pimg->pGSxM == NULL && apipc_image_build(pimg) != APIPC_RC_SUCCESS)
+            {
+                pimg->img_sm = APIPC_OBJ_SM_FAIL;
+                break;
+            }
+
+            if(STATUS_FAIL == apipc_put(plane, (uint32_t) APIPC_IMAGE_WRITE,
+                                        (uint32_t)(uintptr_t) pimg->pGSxM,
+                                        (uint32_t) pimg->len,
+                                        (uint32_t) pimg->nobj, APIPC_PUT_CMD))
+            {
+                plane->stats.tx_fail++;
+                apipc_image_retry(pimg);
+                break;
+            }
+
+            /* image holds a lane slot until its response is received */
+            pimg->tx_lane = plane->id;
+            pimg->inflight = 1;
+            plane->stats.tx_cmd++;
+
+            apipc_lane_take(plane);
+
+            pimg->timer = ipc_read_timer();
+            pimg->img_sm = APIPC_OBJ_SM_WAITTING_RESPONSE;
+            break;
+
+        case APIPC_OBJ_SM_WAITTING_RESPONSE:
+
+            if(ipc_timer_expired(pimg->timer, IPC_TIMER_WAIT_5mS))
+            {
+                apipc_links[APIPC_LINK_0].lane[pimg->tx_lane].stats.timeout++;
+
+                /* the same image is put again, the remote core may still
+                 * be reading it */
+                apipc_image_unslot(pimg);
+                apipc_image_retry(pimg);
+            }
+            break;
+
+        case APIPC_OBJ_SM_RETRY:
+
+            if(ipc_timer_expired(pimg->timer, IPC_TIMER_WAIT_5mS))
+                pimg->img_sm = APIPC_OBJ_SM_WRITING;
+            break;
+
+            /* image was transmitted or failed, nothing else to do */
+        case APIPC_OBJ_SM_IDLE:
+        case APIPC_OBJ_SM_FAIL:
+        case APIPC_OBJ_SM_FREE:
+            break;
+    }
+}
+
+/* apipc_image_apply - copy every obj serialized on a remote image to its local
+ * address. Receive hooks run once every obj was copied */
+static void apipc_image_apply(struct apipc_link *plink, tIpcMessage *psMessage)
+{
+    struct apipc_obj *plobj;
+    uint16_t *pdata;
+    uint16_t *pend;
+    uint16_t obj_idx;
+    uint16_t len;
+    uint16_t landed[APIPC_MAX_OBJ];
+    uint16_t nlanded;
+
+    pdata = (uint16_t *)(uintptr_t) psMessage->uladdress;
+    pend = pdata + (uint16_t) psMessage->uldataw1;
+    nlanded = 0;
+
+    while(pdata + 2 <= pend)
+    {
+        obj_idx = *pdata++;
+        len = *pdata++;
+
+        /* a malformed image is applied up to the last consistent obj */
+        if(pdata + len > pend)
+            break;
+
+        if(obj_idx < APIPC_MAX_OBJ)
+        {
+            plobj = &plink->l_obj[obj_idx];
+
+            if(plobj->paddr != NULL && plobj->len == len &&
+               nlanded < APIPC_MAX_OBJ)
+            {
+                u16memcpy(plobj->paddr, pdata, len);
+                landed[nlanded++] = obj_idx;
+            }
+        }
+
+        pdata += len;
+    }
+
+    for(len = 0; len < nlanded; len++)
+        apipc_rx_landed(landed[len]);
+}
+
+/* apipc_rx_notify - run the receive hook of the obj a remote write landed on.
+ * Streamed blocks notify once their last fragment landed */
+static void apipc_rx_notify(struct apipc_link *plink, tIpcMessage *psMessage)
+{
+    struct apipc_obj *plobj;
+    uint16_t *paddr;
+    uint16_t obj_idx;
+
+    paddr = (uint16_t *)(uintptr_t) psMessage->uladdress;
+    plobj = plink->l_obj;
+
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++, plobj++)
+    {
+        if(plobj->paddr == NULL || paddr < (uint16_t *)plobj->paddr ||
+           paddr >= (uint16_t *)plobj->paddr + plobj->len)
+            continue;
+
+        if(psMessage->ulcommand == IPC_BLOCK_WRITE &&
+           paddr + (uint16_t)psMessage->uldataw1 != (uint16_t *)plobj->paddr + plobj->len)
+            return;
+
+        apipc_rx_landed(obj_idx);
+
+        return;
+    }
+}
+
+/* apipc_rx_landed - remote data landed on a local obj. Snapshots are
+ * published and the receive hook is run */
+static void apipc_rx_landed(uint16_t obj_idx)
+{
+    uint16_t key;
+    uint16_t s;
+
+    if(apipc_ctl.psnap[obj_idx] != NULL)
+    {
+        key = __disable_interrupts();
+
+        /* back turns the published middle, old middle takes the next writes */
+        s = apipc_ctl.snap[obj_idx];
+        apipc_ctl.snap[obj_idx] = APIPC_SNAP(APIPC_SNAP_MIDDLE(s), APIPC_SNAP_BACK(s), APIPC_SNAP_FRONT(s)) |
+                                  (s & APIPC_SNAP_HELD) | APIPC_SNAP_FRESH;
+        s = apipc_ctl.snap[obj_idx];
+
+        __restore_interrupts(key);
+
+        /* remote core reads the descriptor to address the next write */
+        APIPC_LOBJ(obj_idx)->paddr = apipc_ctl.psnap[obj_idx] + APIPC_SNAP_BACK(s) * APIPC_LOBJ(obj_idx)->len;
+    }
+
+    if(apipc_ctl.rx_hook[obj_idx] != NULL)
+        apipc_ctl.rx_hook[obj_idx](obj_idx, ipc_read_timer());
+}
+
+/* apipc_image_response - take actions over a received image response */
+static void apipc_image_response(tIpcMessage *psMessage)
+{
+    struct apipc_image *pimg;
+
+    pimg = &tx_img;
+
+#if APIPC_STARTUP_IMAGE
+    if((uint16_t *)(uintptr_t) psMessage->uladdress == startup_img.pGSxM)
+        pimg = &startup_img;
+#endif
+
+    if(pimg->img_sm == APIPC_OBJ_SM_WAITTING_RESPONSE &&
+       (uint16_t *)(uintptr_t) psMessage->uladdress == pimg->pGSxM)
+    {
+        apipc_image_release(pimg);
+        pimg->img_sm = APIPC_OBJ_SM_IDLE;
+    }
+}
+
+/* apipc_tx_begin - open a transaction */
+enum apipc_rc apipc_tx_begin(void)
+{
+    uint16_t obj_idx;
+
+    /* the committed one is still on his way */
+    if(tx_img.img_sm != APIPC_OBJ_SM_FREE && tx_img.img_sm != APIPC_OBJ_SM_IDLE &&
+       tx_img.img_sm != APIPC_OBJ_SM_FAIL)
+        return APIPC_RC_BUSY;
+
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+        apipc_ctl.flag[obj_idx].txn = 0;
+
+    tx_open = 1;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_tx_add - add an obj to the open transaction */
+enum apipc_rc apipc_tx_add(uint16_t obj_idx)
+{
+    struct apipc_obj *plobj;
+
+    if(!tx_open || obj_idx >= APIPC_MAX_OBJ ||
+       apipc_ctl.link[obj_idx] != APIPC_LINK_0)
+        return APIPC_RC_FAIL;
+
+    plobj = APIPC_LOBJ(obj_idx);
+
+    if(plobj->paddr == NULL || plobj->type == APIPC_OBJ_TYPE_FUNC_CALL ||
+       plobj->len > APIPC_STREAM_CHUNK)
+        return APIPC_RC_FAIL;
+
+    apipc_ctl.flag[obj_idx].txn = 1;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_tx_commit - copy the open transaction objs on his image and hand it
+ * to apipc_app() */
+enum apipc_rc apipc_tx_commit(void)
+{
+    enum apipc_rc rc;
+
+    if(!tx_open)
+        return APIPC_RC_FAIL;
+
+    tx_img.pGSxM = NULL;
+
+    rc = apipc_image_build(&tx_img);
+
+    /* only a full pool is worth committing again */
+    if(rc == APIPC_RC_BUSY)
+        return rc;
+
+    if(rc == APIPC_RC_FAIL)
+    {
+        tx_open = 0;
+        return rc;
+    }
+
+    tx_open = 0;
+    tx_img.img_sm = APIPC_OBJ_SM_INIT;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_tx_state - consult the last committed transaction sm state */
+enum apipc_obj_sm apipc_tx_state(void)
+{
+    return tx_img.img_sm;
+}
+
+/* apipc_rpc_register - register a remote procedure handler */
+enum apipc_rc apipc_rpc_register(uint16_t fn_id, apipc_rpc_handler handler)
+{
+    if(fn_id >= APIPC_RPC_MAX_FUNC || handler == NULL)
+        return APIPC_RC_FAIL;
+
+    rpc_handlers[fn_id] = handler;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_rpc_call - marshall the arguments and request the remote core to run a
+ * registered handler */
+uint16_t apipc_rpc_call(uint16_t fn_id, const void *args, uint16_t args_len,
+                        void *ret, uint16_t ret_max)
+{
+    struct apipc_rpc *prpc;
+    struct apipc_lane *plane;
+    uint16_t slot;
+
+    if(init_sm != APIPC_INIT_SM_DONE)
+        return APIPC_RPC_HANDLE_NONE;
+
+    if((args_len && args == NULL) || (ret_max && ret == NULL))
+        return APIPC_RPC_HANDLE_NONE;
+
+    /* look for a free call slot */
+    for(slot = 0, prpc = rpc_calls; slot < APIPC_RPC_MAX_CALLS; slot++, prpc++)
+        if(!prpc->busy && prpc->pGSxM == NULL)
+            break;
+
+    if(slot == APIPC_RPC_MAX_CALLS)
+        return APIPC_RPC_HANDLE_NONE;
+
+    /* calls are put on the APIPC_LINK_0 peer */
+    plane = apipc_lane_pick(&apipc_links[APIPC_LINK_0], APIPC_LANE_AUTO);
+
+    if(plane->inflight >= APIPC_LANE_BUDGET || apipc_lane_held(plane))
+        return APIPC_RPC_HANDLE_NONE;
+
+    /* marshall the arguments on sender owned shared memory */
+    prpc->pGSxM = NULL;
+
+    if(args_len)
+    {
+        prpc->pGSxM = (uint16_t *) apipc_stage_alloc(plane->plink, (size_t)args_len);
+
+        if(prpc->pGSxM == NULL)
+            return APIPC_RPC_HANDLE_NONE;
+
+        u16memcpy(prpc->pGSxM, args, args_len);
+    }
+
+    prpc->gen = (prpc->gen + 1) & 0xFF;
+
+    /* the caller waits the result, calls aren't coalesced */
+    if(STATUS_FAIL == apipc_put(plane, (uint32_t) APIPC_RPC_CALL,
+                                (uint32_t)(uintptr_t) prpc->pGSxM,
+                                ((uint32_t)fn_id << 16) | args_len,
+                                ((uint32_t)ret_max << 16) |
+                                (prpc->gen << 8) | slot,
+                                APIPC_PUT_URGENT))
+    {
+        plane->stats.tx_fail++;
+
+        if(prpc->pGSxM)
+        {
+            apipc_stage_free(prpc->pGSxM);
+            prpc->pGSxM = NULL;
+        }
+        return APIPC_RPC_HANDLE_NONE;
+    }
+
+    /* call holds a lane slot until its return is received */
+    prpc->pret = (uint16_t *) ret;
+    prpc->ret_max = ret_max;
+    prpc->ret_len = 0;
+    prpc->busy = 1;
+    prpc->rc = APIPC_RC_PENDING;
+    prpc->tx_lane = plane->id;
+    prpc->timer = ipc_read_timer();
+    plane->stats.tx_cmd++;
+
+    apipc_lane_take(plane);
+
+    return (prpc->gen << 8) | slot;
+}
+
+/* apipc_rpc_status - consult a remote procedure call completion */
+enum apipc_rc apipc_rpc_status(uint16_t handle, uint16_t *pret_len)
+{
+    struct apipc_rpc *prpc;
+    enum apipc_rc rc;
+
+    if((handle & 0xFF) >= APIPC_RPC_MAX_CALLS)
+        return APIPC_RC_FAIL;
+
+    prpc = &rpc_calls[handle & 0xFF];
+
+    if(!prpc->busy || prpc->gen != (handle >> 8))
+        return APIPC_RC_FAIL;
+
+    rc = prpc->rc;
+
+    if(rc == APIPC_RC_PENDING)
+        return rc;
+
+    if(pret_len)
+        *pret_len = prpc->ret_len;
+
+    /* completion was reported, release the slot */
+    prpc->pret = NULL;
+    prpc->busy = 0;
+
+    return rc;
+}
+
+/* apipc_mbox_register - register a mailbox handler */
+enum apipc_rc apipc_mbox_register(uint16_t id, apipc_mbox_handler handler)
+{
+    if(id >= APIPC_MBOX_MAX_ID)
+        return APIPC_RC_FAIL;
+
+    mbox_handlers[id] = handler;
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_mbox_send - post a short message on the local mailbox */
+ram_func enum apipc_rc apipc_mbox_send(uint16_t id, const uint16_t *data, uint16_t len)
+{
+    uint16_t idx;
+
+    if(id >= APIPC_MBOX_MAX_ID || len > APIPC_MBOX_WORDS || (len && data == NULL))
+        return APIPC_RC_FAIL;
+
+    /* mailbox is busy until the remote core acknowledges the last message */
+    if(IPCLtoRFlagBusy(APIPC_FLAG_IRQ_MBOX))
+        return APIPC_RC_PENDING;
+
+    l_mbox->id = id;
+    l_mbox->len = len;
+
+    for(idx = 0; idx < len; idx++)
+        l_mbox->data[idx] = data[idx];
+
+    IPCLtoRFlagSet(APIPC_FLAG_IRQ_MBOX);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_mbox_dispatch - run the handler of a pending remote mailbox message
+ * and free the mailbox. Returns the number of messages dispatched */
+static uint16_t apipc_mbox_dispatch(void)
+{
+    uint16_t id;
+    uint16_t len;
+
+    if(!IPCRtoLFlagBusy(APIPC_FLAG_IRQ_MBOX))
+        return 0;
+
+    id = r_mbox->id;
+    len = r_mbox->len;
+
+    if(id < APIPC_MBOX_MAX_ID && mbox_handlers[id] != NULL && len <= APIPC_MBOX_WORDS)
+        mbox_handlers[id]((const uint16_t *)r_mbox->data, len);
+
+    /* Acknowledge IPC2 Flag, remote mailbox is free again */
+    IPCRtoLFlagAcknowledge(APIPC_FLAG_IRQ_MBOX);
+
+    return 1;
+}
+
+/* apipc_rpc_serve - run the handler requested by the remote core and return
+ * the result */
+static void apipc_rpc_serve(struct apipc_lane *plane, tIpcMessage *psMessage)
+{
+    apipc_rpc_handler handler;
+    enum apipc_rc rc;
+    uint16_t fn_id;
+    uint16_t ret_max;
+    uint16_t ret_len;
+    uint16_t *pret;
+    uint16_t res;
+
+    fn_id = (uint16_t)(psMessage->uldataw1 >> 16);
+    ret_max = (uint16_t)(psMessage->uldataw2 >> 16);
+    handler = (fn_id < APIPC_RPC_MAX_FUNC) ? rpc_handlers[fn_id] : NULL;
+
+    rc = APIPC_RC_FAIL;
+    ret_len = 0;
+    pret = NULL;
+
+    /* look for a free result slot, calls with nothing to return need none */
+    for(res = 0; ret_max && res < APIPC_RPC_MAX_CALLS; res++)
+        if(rpc_results[res] == NULL)
+            break;
+
+    if(handler != NULL && (ret_max == 0 || res < APIPC_RPC_MAX_CALLS))
+    {
+        if(ret_max)
+            pret = (uint16_t *) apipc_stage_alloc(plane->plink, (size_t)ret_max);
+
+        if(ret_max == 0 || pret != NULL)
+        {
+            ret_len = handler((const uint16_t *)(uintptr_t) psMessage->uladdress,
+                              (uint16_t) psMessage->uldataw1, pret, ret_max);
+
+            if(ret_len > ret_max)
+                ret_len = ret_max;
+
+            rc = APIPC_RC_SUCCESS;
+        }
+    }
+
+    /* result stays on local cl_r_w_data until the caller releases it */
+    if(pret != NULL)
+    {
+        rpc_results[res] = pret;
+        rpc_results_timer[res] = ipc_read_timer();
+        rpc_results_tag[res] = (uint16_t)psMessage->uldataw2;
+    }
+
+    if(STATUS_FAIL == apipc_put(plane, (uint32_t) APIPC_RPC_RETURN,
+                                (uint32_t)(uintptr_t) pret,
+                                ((uint32_t)(uint16_t)rc << 16) | ret_len,
+                                psMessage->uldataw2 & 0xFFFF, APIPC_PUT_RSP))
+    {
+        plane->stats.tx_fail++;
+
+        if(pret != NULL)
+        {
+            apipc_stage_free(pret);
+            rpc_results[res] = NULL;
+        }
+    }
+    else
+        plane->stats.tx_rsp++;
+}
+
+/* apipc_rpc_return - copy a remote procedure result and release it */
+static void apipc_rpc_return(struct apipc_lane *plane, tIpcMessage *psMessage)
+{
+    struct apipc_rpc *prpc;
+    uint16_t slot;
+    uint16_t gen;
+
+    slot = (uint16_t)(psMessage->uldataw2 & 0xFF);
+    gen = (uint16_t)((psMessage->uldataw2 >> 8) & 0xFF);
+
+    if(slot < APIPC_RPC_MAX_CALLS)
+    {
+        prpc = &rpc_calls[slot];
+
+        /* late returns of timed out calls only free the arguments */
+        if(prpc->gen == gen && prpc->rc == APIPC_RC_PENDING)
+        {
+            prpc->rc = (enum apipc_rc)(int16_t)(psMessage->uldataw1 >> 16);
+            prpc->ret_len = (uint16_t) psMessage->uldataw1;
+
+            if(prpc->ret_len > prpc->ret_max)
+                prpc->ret_len = prpc->ret_max;
+
+            if(prpc->rc == APIPC_RC_SUCCESS && prpc->ret_len)
+                u16memcpy(prpc->pret, (uint16_t *)(uintptr_t) psMessage->uladdress,
+                          prpc->ret_len);
+
+            apipc_lane_give(&apipc_links[APIPC_LINK_0].lane[prpc->tx_lane], 1);
+        }
+
+        if(prpc->gen == gen && prpc->pGSxM)
+        {
+            apipc_stage_free(prpc->pGSxM);
+            prpc->pGSxM = NULL;
+        }
+    }
+
+    /* let the remote core free the result space. It isn't a response, so a
+     * queue out of credits is left to free it on APIPC_RPC_TIMEOUT */
+    if(psMessage->uladdress && !apipc_lane_held(plane))
+    {
+        if(STATUS_FAIL == apipc_put(plane, (uint32_t) APIPC_MESSAGE,
+                                    psMessage->uladdress,
+                                    (uint32_t) APIPC_MSG_CMD_RPC_RETURN_RSP,
+                                    psMessage->uldataw2 & 0xFFFF, APIPC_PUT_RSP))
+            plane->stats.tx_fail++;
+        else
+            plane->stats.tx_rsp++;
+    }
+}
+
+/* apipc_rpc_release - free a result already copied by the caller. A repeated
+ * release may come once the space holds a newer result, the tag tells them
+ * apart */
+static void apipc_rpc_release(tIpcMessage *psMessage)
+{
+    uint16_t res;
+
+    for(res = 0; res < APIPC_RPC_MAX_CALLS; res++)
+        if(rpc_results[res] != NULL &&
+           rpc_results[res] == (uint16_t *)(uintptr_t) psMessage->uladdress &&
+           rpc_results_tag[res] == (uint16_t) psMessage->uldataw2)
+        {
+            apipc_stage_free(rpc_results[res]);
+            rpc_results[res] = NULL;
+        }
+}
+
+/* apipc_rpc_proc - time out calls and results that were never released */
+static void apipc_rpc_proc(void)
+{
+    struct apipc_rpc *prpc;
+    uint16_t slot;
+
+    for(slot = 0, prpc = rpc_calls; slot < APIPC_RPC_MAX_CALLS; slot++, prpc++)
+    {
+        if(prpc->rc == APIPC_RC_PENDING &&
+           ipc_timer_expired(prpc->timer, APIPC_RPC_TIMEOUT))
+        {
+            /*
+             * Arguments are kept until a late return, if any, releases them.
+             * Otherwise they are freed on the next timer expiration.
+             */
+            apipc_links[APIPC_LINK_0].lane[prpc->tx_lane].stats.timeout++;
+            apipc_lane_give(&apipc_links[APIPC_LINK_0].lane[prpc->tx_lane], 1);
+            prpc->rc = APIPC_RC_TIMEOUT;
+            prpc->timer = ipc_read_timer();
+        }
+        else if(prpc->rc != APIPC_RC_PENDING && prpc->pGSxM &&
+                ipc_timer_expired(prpc->timer, APIPC_RPC_TIMEOUT))
+        {
+            apipc_stage_free(prpc->pGSxM);
+            prpc->pGSxM = NULL;
+        }
+
+        if(rpc_results[slot] != NULL &&
+           ipc_timer_expired(rpc_results_timer[slot], APIPC_RPC_TIMEOUT))
+        {
+            apipc_stage_free(rpc_results[slot]);
+            rpc_results[slot] = NULL;
+        }
+    }
+}
+
+/* apipc_cmd_response - apipc response the received message over ipc to ack
+ * reception */
+static void apipc_cmd_response (struct apipc_lane *plane, tIpcMessage *psMessage)
+{
+    enum apipc_msg_cmd cmd_response;
+     uint16_t *urAddess = NULL;
+     uint32_t ulDataW1 = 0;
      uint32_t ulDataW2 = 0;
 
-    cmd_response = (enum apipc_msg_cmd) psMessage->ulcommand;
+    cmd_response = (enum apipc_msg_cmd) psMessage->ulcommand;
+
+    /* build response according to received ipc command */
+    switch(cmd_response)
+    {
+        case APIPC_MSG_CMD_FUNC_CALL_RSP:
+        case APIPC_MSG_CMD_SET_BITS_RSP:
+        case APIPC_MSG_CMD_CLEAR_BITS_RSP:
+        case APIPC_MSG_CMD_DATA_WRITE_RSP:
+            urAddess = (uint16_t *)(uintptr_t) psMessage->uladdress;
+            ulDataW1 = (uint32_t) cmd_response;
+            break;
+
+        case APIPC_MSG_CMD_BLOCK_READ_RSP:
+            return;
+
+        case APIPC_MSG_CMD_BLOCK_WRITE_RSP:
+            /* echo the staging address so fragments can be told apart */
+            urAddess = (uint16_t *)(uintptr_t) psMessage->uladdress;
+            ulDataW1 = (uint32_t) cmd_response;
+            ulDataW2 = psMessage->uldataw2;
+            break;
+
+        case APIPC_MSG_CMD_IMAGE_WRITE_RSP:
+        case APIPC_MSG_CMD_DELTA_WRITE_RSP:
+            urAddess = (uint16_t *)(uintptr_t) psMessage->uladdress;
+            ulDataW1 = (uint32_t) cmd_response;
+            break;
+
+        case APIPC_MSG_CMD_CRC_WRITE_RSP:
+            /* uldataw2 holds the check apipc_rc */
+            urAddess = (uint16_t *)(uintptr_t) psMessage->uladdress;
+            ulDataW1 = (uint32_t) cmd_response;
+            ulDataW2 = psMessage->uldataw2;
+            break;
+
+        case APIPC_MSG_CMD_INLINE_WRITE_RSP:
+            urAddess = (uint16_t *)(uintptr_t) psMessage->uladdress;
+            ulDataW1 = (uint32_t) cmd_response;
+            break;
+
+        case APIPC_MSG_CMD_LEASE_WRITE_RSP:
+            /* echo the lease generation */
+            urAddess = (uint16_t *)(uintptr_t) psMessage->uladdress;
+            ulDataW1 = (uint32_t) cmd_response;
+            ulDataW2 = (uint32_t) APIPC_LEASE_GEN(psMessage->uldataw1);
+            break;
+
+        case APIPC_MSG_CMD_LEASE_RELEASE_RSP:
+            /* echo the released generation */
+            urAddess = (uint16_t *)(uintptr_t) psMessage->uladdress;
+            ulDataW1 = (uint32_t) cmd_response;
+            ulDataW2 = psMessage->uldataw1;
+            break;
+
+        case APIPC_MSG_CMD_KEYED_WRITE_RSP:
+            /* echo the applied generation */
+            urAddess = (uint16_t *)(uintptr_t) psMessage->uladdress;
+            ulDataW1 = (uint32_t) cmd_response;
+            ulDataW2 = (uint32_t) APIPC_KEYED_GEN(psMessage->uldataw1);
+            break;
+
+        case APIPC_MSG_CMD_RPC_RETURN_RSP:
+            return;
+
+        case APIPC_MSG_CMD_DATA_READ_PROTECTED_RSP:
+        case APIPC_MSG_CMD_SET_BITS_PROTECTED_RSP:
+        case APIPC_MSG_CMD_CLEAR_BITS_PROTECTED_RSP:
+        case APIPC_MSG_CMD_DATA_WRITE_PROTECTED_RSP:
+        case APIPC_MSG_CMD_BLOCK_WRITE_PROTECTED_RSP:
+            return;
+    }
+
+    /* request ipc driver write, response goes back on the command lane */
+    if(STATUS_FAIL == apipc_put(plane, (uint32_t) APIPC_MESSAGE,
+                (uint32_t)(uintptr_t) urAddess, ulDataW1, ulDataW2, APIPC_PUT_RSP))
+        plane->stats.tx_fail++;
+    else
+        plane->stats.tx_rsp++;
+}
+
+/* apipc_message_handler - handle the received messege */
+static void apipc_message_handler (struct apipc_link *plink,
+                                   tIpcMessage *psMessage)
+{
+    enum apipc_msg_cmd ulCommand;
+
+    uint16_t obj_idx = 0;
+    uint16_t *pusRAddress;
+    uint16_t key;
+
+    struct apipc_obj *plobj;
+    struct apipc_obj *probj;
+
+    /* initialize local variables, responses are searched on the link they
+     * were received on */
+    plobj = plink->l_obj;
+    probj = plink->r_obj;
+
+    pusRAddress = (uint16_t *)(uintptr_t) psMessage->uladdress;
+    ulCommand = (enum apipc_msg_cmd) psMessage->uldataw1;
+
+    /* images & rpc responses dont belong to a single obj */
+    if(ulCommand == APIPC_MSG_CMD_IMAGE_WRITE_RSP)
+    {
+        apipc_image_response(psMessage);
+        return;
+    }
+
+    if(ulCommand == APIPC_MSG_CMD_RPC_RETURN_RSP)
+    {
+        apipc_rpc_release(psMessage);
+        return;
+    }
+
+    if(ulCommand == APIPC_MSG_CMD_LEASE_RELEASE_RSP)
+    {
+        apipc_lease_acked(plink, psMessage);
+        return;
+    }
+
+    if(ulCommand == APIPC_MSG_CMD_BLOCK_WRITE_RSP &&
+       apipc_stream_response(psMessage) == APIPC_RC_SUCCESS)
+        return;
+
+    /* search the obj_idx corresponding to the response */
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; plobj++, probj++, obj_idx++)
+    {
+        if(plobj->type == APIPC_OBJ_TYPE_SNAPSHOT)
+        {
+            if(plobj->paddr != NULL && pusRAddress == apipc_ctl.pdst[obj_idx])
+                break;
+        }
+        else if(pusRAddress == probj->paddr)
+            break;
+    }
+
+    /* response doesnt belong to any registered obj */
+    if(obj_idx == APIPC_MAX_OBJ)
+        return;
+
+    /* streamed objs complete on their last fragment, a late one is ignored */
+    if((plobj->type == APIPC_OBJ_TYPE_BLOCK || plobj->type == APIPC_OBJ_TYPE_SNAPSHOT) &&
+       plobj->len > APIPC_STREAM_CHUNK)
+        return;
+
+    /* take actions according to the received ipc command */
+    switch(ulCommand)
+    {
+        case APIPC_MSG_CMD_FUNC_CALL_RSP:
+        	pusRAddress = probj->paddr;
+            break;
+
+        case APIPC_MSG_CMD_SET_BITS_RSP:
+        case APIPC_MSG_CMD_CLEAR_BITS_RSP:
+            /* bits commands complete out of the obj sm, a late one after
+             * their timeout completes nothing */
+            if(apipc_ctl.bits[obj_idx])
+            {
+                apipc_ctl.bits[obj_idx]--;
+                apipc_lane_give(&plink->lane[apipc_ctl.tx_lane[obj_idx]], 1);
+            }
+            return;
+
+        case APIPC_MSG_CMD_DATA_WRITE_RSP:
+        case APIPC_MSG_CMD_BLOCK_READ_RSP:
+        case APIPC_MSG_CMD_INLINE_WRITE_RSP:
+            break;
+
+        case APIPC_MSG_CMD_LEASE_WRITE_RSP:
+            /* a repeated or late response completes nothing, the lease write
+             * waiting could be lost yet */
+            if(apipc_ctl.lease[obj_idx] == APIPC_LEASE_MAX ||
+               (uint16_t)psMessage->uldataw2 != apipc_ctl.gen[obj_idx])
+                return;
+
+            /* remote core holds the lent staging, his release frees it */
+            apipc_ctl.pGSxM[obj_idx] = NULL;
+            apipc_ctl.lease[obj_idx] = APIPC_LEASE_MAX;
+            break;
+
+        case APIPC_MSG_CMD_BLOCK_WRITE_RSP:
+        case APIPC_MSG_CMD_DELTA_WRITE_RSP:
+            apipc_obj_release(obj_idx);
+            break;
+
+        case APIPC_MSG_CMD_CRC_WRITE_RSP:
+            apipc_obj_release(obj_idx);
+
+            /* remote core rejected a corrupted block, transmit it again */
+            if(psMessage->uldataw2 != (uint32_t) APIPC_RC_SUCCESS &&
+               apipc_ctl.obj_sm[obj_idx] == APIPC_OBJ_SM_WAITTING_RESPONSE)
+            {
+                apipc_obj_retry(obj_idx);
+                return;
+            }
+            break;
+
+        case APIPC_MSG_CMD_KEYED_WRITE_RSP:
+            /* the newest write acknowledges the superseded ones, an older
+             * one completes nothing */
+            if((uint16_t)psMessage->uldataw2 != apipc_ctl.gen[obj_idx])
+                return;
+
+            /* objs apipc_send_isr() put complete out of their sm */
+            key = __disable_interrupts();
+
+            if(apipc_ctl.isr_req[obj_idx] == APIPC_ISR_PUT &&
+               apipc_ctl.obj_sm[obj_idx] == APIPC_OBJ_SM_IDLE)
+            {
+                apipc_obj_release(obj_idx);
+                apipc_ctl.isr_req[obj_idx] = APIPC_ISR_NONE;
+                stats.tx_done++;
+                stats.tx_words += plobj->len;
+            }
+
+            __restore_interrupts(key);
+            break;
+
+        case APIPC_MSG_CMD_DATA_READ_PROTECTED_RSP:
+        case APIPC_MSG_CMD_SET_BITS_PROTECTED_RSP:
+        case APIPC_MSG_CMD_CLEAR_BITS_PROTECTED_RSP:
+        case APIPC_MSG_CMD_DATA_WRITE_PROTECTED_RSP:
+        case APIPC_MSG_CMD_BLOCK_WRITE_PROTECTED_RSP:
+        case APIPC_MSG_CMD_IMAGE_WRITE_RSP:
+        case APIPC_MSG_CMD_RPC_RETURN_RSP:
+        case APIPC_MSG_CMD_LEASE_RELEASE_RSP:
+            break;
+    }
+    
+    /* evolve obj sm */
+    switch (apipc_ctl.obj_sm[obj_idx])
+    {
+        case APIPC_OBJ_SM_IDLE:
+            break;
+
+        case APIPC_OBJ_SM_WAITTING_RESPONSE:
+            apipc_obj_release(obj_idx);
+            apipc_obj_done(obj_idx);
+            break;
+
+        default:
+            /* a split staging copy isn't resumed on a reset obj */
+            apipc_obj_release(obj_idx);
+            apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_UNKNOWN;
+            break;
+    }
+}
+
+/* apipc_app - apipc application */
+void apipc_app(void)
+{
+    static enum apipc_sm apipc_app_sm = APIPC_SM_UNKNOWN;
+
+    uint16_t obj_idx;
+
+    /* nothing to process until apipc is inited on both cores */
+    if(init_sm != APIPC_INIT_SM_DONE)
+        return;
+
+#if !APIPC_POLLED
+    apipc_process_messages();
+#endif
+
+#if APIPC_FAULT_INJECT
+    apipc_fault_proc();
+#endif
+
+    apipc_rpc_proc();
+
+    apipc_stream_proc();
+
+    apipc_probe_proc();
+
+    apipc_lease_proc();
+
+    switch(apipc_app_sm)
+    {
+        case APIPC_SM_UNKNOWN:
+            if(IPCRtoLFlagBusy(APIPC_FLAG_API_INITED) && IPCLtoRFlagBusy(APIPC_FLAG_API_INITED))
+#if defined( CPU2 )
+                if(IPCRtoLFlagBusy(APIPC_FLAG_APP_START))
+#endif
+                    apipc_app_sm = APIPC_SM_STARTUP_REMOTE;
+            break;
+
+        case APIPC_SM_STARTUP_REMOTE:
+            if(!apipc_startup_remote())
+            {
+                apipc_app_sm = APIPC_SM_STARTED;
+                IPCLtoRFlagSet(APIPC_FLAG_APP_START);
+            }
+            break;
+
+        case APIPC_SM_STARTED:
+
+            apipc_isr_proc();
+
+            apipc_image_proc(&tx_img);
+
+            /* walk the whole table once, starting where the last call left */
+            for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+            {
+                apipc_proc_obj(app_next_obj);
+
+                if(++app_next_obj == APIPC_MAX_OBJ)
+                    app_next_obj = 0;
+
+                if(apipc_budget_expired())
+                    break;
+            }
+
+            break;
+
+        case APIPC_SM_IDLE:
+            break;
+    }
+
+    /* coalesced puts waited long enough */
+    apipc_lane_flush(0);
+}
+
+/* apipc_app_budgeted - apipc application bounded to a time budget */
+void apipc_app_budgeted(uint64_t ticks)
+{
+    app_budget_timer = ipc_read_timer();
+    app_budget = ticks;
+
+    apipc_app();
+
+    app_budget = 0;
+}
+
+/* apipc_startup_remote - Initialize local object data on the remote core */
+enum apipc_rc apipc_startup_remote(void)
+{
+    enum apipc_rc rc;
+    uint16_t obj_idx;
+#if APIPC_STARTUP_IMAGE
+    struct apipc_obj *plobj;
+#endif
+
+    rc = APIPC_RC_SUCCESS;
+
+#if APIPC_STARTUP_IMAGE
+    /* startup flagged objs are serialized on a single image first */
+    if(startup_img.img_sm == APIPC_OBJ_SM_UNKNOWN)
+    {
+        for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+        {
+            plobj = APIPC_LOBJ(obj_idx);
+            apipc_ctl.flag[obj_idx].image = (apipc_ctl.link[obj_idx] == APIPC_LINK_0 &&
+                                 plobj->paddr != NULL && apipc_ctl.flag[obj_idx].startup &&
+                                 plobj->type != APIPC_OBJ_TYPE_FUNC_CALL &&
+                                 plobj->len <= APIPC_STREAM_CHUNK);
+        }
+    }
+
+    apipc_image_proc(&startup_img);
+
+    switch(startup_img.img_sm)
+    {
+        case APIPC_OBJ_SM_IDLE:
+            /* image was applied on remote, its objs are already started */
+            for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+                if(apipc_ctl.flag[obj_idx].image)
+                {
+                    apipc_ctl.flag[obj_idx].image = 0;
+                    apipc_ctl.obj_sm[obj_idx] = APIPC_OBJ_SM_IDLE;
+                }
+            break;
+
+        case APIPC_OBJ_SM_FAIL:
+            /* objs fall back to be started one by one */
+            for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+                apipc_ctl.flag[obj_idx].image = 0;
+            break;
+
+        default:
+            return APIPC_RC_FAIL;
+    }
+
+#endif
+
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
+    {
+        apipc_proc_obj(obj_idx);
+
+        if(apipc_ctl.obj_sm[obj_idx] != APIPC_OBJ_SM_FREE && apipc_ctl.obj_sm[obj_idx] != APIPC_OBJ_SM_IDLE)
+        	rc = APIPC_RC_FAIL;
+    }
+
+    return rc;
+}
+
+#if !APIPC_POLLED
+/* apipc_process_messages - apipc interacs here with ipc driver on received
+ * messages and take action according to the command */
+static enum apipc_rc apipc_process_messages(void)
+{
+    enum apipc_rc rc;
+    tIpcMessage sMessage;
+    uint16_t link_idx;
+    uint16_t lane_idx;
+    struct apipc_link *plink;
+    struct apipc_lane *plane;
+
+    rc = APIPC_RC_SUCCESS;
+    plink = apipc_links;
+
+    /* every link lane is served with one message per call */
+    for(link_idx = 0; link_idx < APIPC_MAX_LINK; link_idx++, plink++)
+    {
+        if(plink->l_obj == NULL)
+            continue;
+
+        plane = plink->lane;
+
+        for(lane_idx = 0; lane_idx < APIPC_MAX_LANE; lane_idx++, plane++)
+        {
+            if(circular_buffer_pop(plane->message_cbh, (void *)&sMessage))
+            {
+                /* drops are published even if nothing is left to take */
+                apipc_lane_publish(plane);
+                continue;
+            }
+
+            plane->rx_taken++;
+            apipc_lane_publish(plane);
+
+            /* keyed writes received before the message are applied first */
+            apipc_keyed_flush(plane, ++plane->rx_seq, APIPC_MAX_OBJ);
+
+            if(apipc_message_recv(plane, &sMessage) != APIPC_RC_SUCCESS)
+                rc = APIPC_RC_FAIL;
+        }
+    }
+
+    /* only the newest keyed write of each obj is applied */
+    apipc_keyed_proc(APIPC_MAX_OBJ);
+
+    /* responses put by this pass are raised at once */
+    apipc_lane_flush(1);
+
+    return rc;
+}
+#endif
+
+/* apipc_poll - process received messages up to max_msgs */
+uint16_t apipc_poll(uint16_t max_msgs)
+{
+    tIpcMessage sMessage;
+    uint16_t link_idx;
+    uint16_t lane_idx;
+    uint16_t nmsg;
+    uint16_t got;
+    struct apipc_link *plink;
+    struct apipc_lane *plane;
+
+    nmsg = 0;
+
+    if(init_sm != APIPC_INIT_SM_DONE)
+        return nmsg;
+
+#if APIPC_POLLED
+    /* the mailbox counts against the bound as any other message */
+    if(nmsg < max_msgs)
+        nmsg += apipc_mbox_dispatch();
+#endif
+
+#if APIPC_FAULT_INJECT
+    apipc_fault_proc();
+#endif
+
+    /* links lanes are served round robin until the bound or every lane is
+     * empty */
+    do
+    {
+        got = 0;
+        plink = apipc_links;
+
+        for(link_idx = 0; link_idx < APIPC_MAX_LINK; link_idx++, plink++)
+        {
+            if(plink->l_obj == NULL)
+                continue;
+
+            plane = plink->lane;
+
+            for(lane_idx = 0; lane_idx < APIPC_MAX_LANE && nmsg < max_msgs; lane_idx++, plane++)
+            {
+                /* a message may have every pending keyed write of his link
+                 * applied before it, they are kept within the bound */
+                if(nmsg + plink->key_pending >= max_msgs)
+                    break;
+
+#if APIPC_POLLED
+                /* flag only signals, the GetBuffer indexes tell what is pending */
+                if(IPCRtoLFlagBusy(plane->irq_flag))
+                    IPCRtoLFlagAcknowledge(plane->irq_flag);
+
+                if(IpcGet(plane->pctrl, &sMessage, DISABLE_BLOCKING) == STATUS_FAIL)
+                    continue;
+
+                plane->stats.rx_msg++;
+                apipc_probe_stamp(plane, &sMessage);
+
+                /* a stored keyed write counts against the bound, a peer
+                 * streaming them can't keep the call spinning */
+                if(apipc_keyed_store(plane, &sMessage))
+                {
+                    plane->rx_taken++;
+                    apipc_lane_publish(plane);
+                    nmsg++;
+                    got = 1;
+                    continue;
+                }
+
+                plane->rx_queued++;
+#else
+                if(circular_buffer_pop(plane->message_cbh, (void *)&sMessage))
+                {
+                    apipc_lane_publish(plane);
+                    continue;
+                }
+#endif
+                plane->rx_taken++;
+                apipc_lane_publish(plane);
+
+                /* keyed writes received before the message are applied
+                 * first */
+                nmsg += apipc_keyed_flush(plane, ++plane->rx_seq,
+                                          max_msgs - nmsg - 1);
+
+                apipc_message_recv(plane, &sMessage);
+                nmsg++;
+                got = 1;
+            }
+        }
+    } while(got && nmsg < max_msgs);
+
+    /* only the newest keyed write of each obj is applied */
+    if(nmsg < max_msgs)
+        nmsg += apipc_keyed_proc(max_msgs - nmsg);
+
+    /* responses put by this pass are raised at once */
+    apipc_lane_flush(1);
+
+    return nmsg;
+}
+
+/* apipc_message_recv - hand a received message over to be processed, through
+ * the fault injection hook on APIPC_FAULT_INJECT builds */
+static enum apipc_rc apipc_message_recv(struct apipc_lane *plane,
+                                        tIpcMessage *psMessage)
+{
+#if APIPC_FAULT_INJECT
+    uint16_t lane_idx;
+
+    /* held messages are kept per link lane */
+    lane_idx = (uint16_t)(plane->plink - apipc_links) * APIPC_MAX_LANE + plane->id;
+
+    if(fault_handler != NULL)
+    {
+        switch(fault_handler(plane->id, psMessage))
+        {
+            case APIPC_FAULT_DROP:
+                stats.fault_drop++;
+                return APIPC_RC_SUCCESS;
+
+            case APIPC_FAULT_DUP:
+                stats.fault_dup++;
+                apipc_message_proc(plane, psMessage);
+                break;
+
+            case APIPC_FAULT_DELAY:
+                if(fault_held_valid[lane_idx])
+                    break;
+
+                stats.fault_delay++;
+                fault_held[lane_idx] = *psMessage;
+                fault_held_timer[lane_idx] = ipc_read_timer();
+                fault_held_valid[lane_idx] = 1;
+                return APIPC_RC_SUCCESS;
+
+            case APIPC_FAULT_NONE:
+                break;
+        }
+    }
+#endif
+
+    return apipc_message_proc(plane, psMessage);
+}
+
+#if APIPC_FAULT_INJECT
+/* apipc_fault_register - register the received messages fault hook */
+void apipc_fault_register(apipc_fault_handler handler)
+{
+    fault_handler = handler;
+}
+
+/* apipc_fault_proc - process delayed messages once they were held enough */
+static void apipc_fault_proc(void)
+{
+    uint16_t lane_idx;
+
+    for(lane_idx = 0; lane_idx < APIPC_MAX_LINK * APIPC_MAX_LANE; lane_idx++)
+    {
+        if(!fault_held_valid[lane_idx] ||
+           !ipc_timer_expired(fault_held_timer[lane_idx], APIPC_FAULT_DELAY_TICKS))
+            continue;
+
+        fault_held_valid[lane_idx] = 0;
+        apipc_message_proc(&apipc_links[lane_idx / APIPC_MAX_LANE].lane[lane_idx % APIPC_MAX_LANE],
+                           &fault_held[lane_idx]);
+    }
+}
+#endif
+
+/* apipc_message_proc - take action on a received message according to the
+ * command */
+static enum apipc_rc apipc_message_proc(struct apipc_lane *plane,
+                                        tIpcMessage *psMessage)
+{
+    enum apipc_rc rc;
+
+    rc = APIPC_RC_SUCCESS;
+
+    switch(psMessage->ulcommand)
+    {
+        case IPC_FUNC_CALL:
+            IPCRtoLFunctionCall(psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case IPC_DATA_WRITE:
+            IPCRtoLDataWrite(psMessage);
+            apipc_rx_notify(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case IPC_BLOCK_READ:
+            IPCRtoLBlockRead(psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case IPC_BLOCK_WRITE:
+            IPCRtoLBlockWrite(psMessage);
+            /* snapshots are published before responding, the remote core
+             * addresses his next write with the published descriptor */
+            apipc_rx_notify(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case IPC_SET_BITS:
+            IPCRtoLSetBits(psMessage);
+            apipc_rx_notify(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case IPC_CLEAR_BITS:
+            IPCRtoLClearBits(psMessage);
+            apipc_rx_notify(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case APIPC_IMAGE_WRITE:
+            apipc_image_apply(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case APIPC_CRC_WRITE:
+            /* check result travels back on the response */
+            psMessage->uldataw2 = (uint32_t) apipc_crc_apply(psMessage);
+            if(psMessage->uldataw2 == (uint32_t) APIPC_RC_SUCCESS)
+                apipc_rx_notify(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case APIPC_DELTA_WRITE:
+            apipc_delta_apply(plane->plink, psMessage);
+            apipc_rx_notify(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case APIPC_KEYED_WRITE:
+            apipc_keyed_apply(psMessage);
+            apipc_rx_notify(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case APIPC_INLINE_WRITE:
+            apipc_inline_apply(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case APIPC_LEASE_WRITE:
+            apipc_lease_land(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case APIPC_LEASE_RELEASE:
+            apipc_lease_free(plane->plink, psMessage);
+            apipc_cmd_response(plane, psMessage);
+            break;
+
+        case APIPC_RPC_CALL:
+            apipc_rpc_serve(plane, psMessage);
+            break;
+
+        case APIPC_PROBE:
+            apipc_probe_echo(plane, psMessage);
+            break;
+
+        case APIPC_PROBE_ECHO:
+            apipc_probe_done(plane->plink, psMessage);
+            break;
+
+        case APIPC_RPC_RETURN:
+            apipc_rpc_return(plane, psMessage);
+            break;
+
+        case APIPC_MESSAGE:
+            apipc_message_handler(plane->plink, psMessage);
+            break;
+
+        default:
+            rc = APIPC_RC_FAIL;
+            break;
+    }
+    return rc;
+}
+
+/* apipc_lane_drain - get messages from the lane driver as long as its
+ * GetBuffer is full and store them on the lane queue to be processed */
+static void apipc_lane_drain(struct apipc_lane *plane)
+{
+    tIpcMessage sMessage;
+
+    while(IpcGet(plane->pctrl, &sMessage, DISABLE_BLOCKING)!= STATUS_FAIL)
+    {
+        plane->stats.rx_msg++;
+        apipc_probe_stamp(plane, &sMessage);
+
+        /* keyed writes are kept on the link obj slots instead */
+        if(apipc_keyed_store(plane, &sMessage))
+        {
+            plane->rx_keyed++;
+            continue;
+        }
+
+        if(circular_buffer_put(plane->message_cbh, (void *)&sMessage))
+            plane->stats.rx_drop++;
+        else
+            plane->rx_queued++;
+    }
+}
 
-    /* build response according to received ipc command */
-    switch(cmd_response)
+/* apipc_keyed_store - keep a received keyed write on his link obj slot unless
+ * a newer one is already pending. Returns 0 if the message isn't a keyed write
+ * and has to be queued. Runs on the lane ISR, or from apipc_poll() on
+ * APIPC_POLLED builds */
+static uint16_t apipc_keyed_store(struct apipc_lane *plane, tIpcMessage *psMessage)
+{
+    struct apipc_link *plink;
+    uint16_t obj_idx;
+
+    if(psMessage->ulcommand != APIPC_KEYED_WRITE)
+        return 0;
+
+    plink = plane->plink;
+    obj_idx = APIPC_KEYED_OBJ(psMessage->uldataw1);
+
+    if(obj_idx >= APIPC_MAX_OBJ)
+        return 0;
+
+    if(plink->key_lane[obj_idx] != APIPC_MAX_LANE)
     {
-        case APIPC_MSG_CMD_FUNC_CALL_RSP:
-        case APIPC_MSG_CMD_SET_BITS_RSP:
-        case APIPC_MSG_CMD_CLEAR_BITS_RSP:
-        case APIPC_MSG_CMD_DATA_WRITE_RSP:
-            urAddess = (uint16_t *) psMessage->uladdress;
-            ulDataW1 = (uint32_t) cmd_response;
-            break;
+        /* one of both writes is superseded, generations may wrap */
+        plane->stats.rx_superseded++;
 
-        case APIPC_MSG_CMD_BLOCK_READ_RSP:
-            return;
+        if((int16_t)(APIPC_KEYED_GEN(psMessage->uldataw1) -
+                     APIPC_KEYED_GEN(plink->rx_key[obj_idx].uldataw1)) <= 0)
+            return 1;
+    }
+    else
+        plink->key_pending++;
 
-        case APIPC_MSG_CMD_BLOCK_WRITE_RSP:
-            urAddess = (uint16_t *) psMessage->uladdress;
-            ulDataW1 = (uint32_t) cmd_response;
-            break;
+    plink->rx_key[obj_idx] = *psMessage;
+    plink->key_lane[obj_idx] = plane->id;
+    plink->key_mark[obj_idx] = plane->rx_queued;
 
-        case APIPC_MSG_CMD_DATA_READ_PROTECTED_RSP:
-        case APIPC_MSG_CMD_SET_BITS_PROTECTED_RSP:
-        case APIPC_MSG_CMD_CLEAR_BITS_PROTECTED_RSP:
-        case APIPC_MSG_CMD_DATA_WRITE_PROTECTED_RSP:
-        case APIPC_MSG_CMD_BLOCK_WRITE_PROTECTED_RSP:
-            return;
+    return 1;
+}
+
+/* apipc_keyed_proc - apply the pending keyed writes up to max_msgs, returns
+ * the number applied */
+static uint16_t apipc_keyed_proc(uint16_t max_msgs)
+{
+    tIpcMessage sMessage;
+    uint16_t link_idx;
+    uint16_t obj_idx;
+    uint16_t lane_idx;
+    uint16_t nmsg;
+    struct apipc_link *plink;
+
+    nmsg = 0;
+    plink = apipc_links;
+
+    for(link_idx = 0; link_idx < APIPC_MAX_LINK; link_idx++, plink++)
+    {
+        if(plink->l_obj == NULL)
+            continue;
+
+        for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ && plink->key_pending; obj_idx++)
+        {
+            if(nmsg >= max_msgs)
+                return nmsg;
+
+            lane_idx = apipc_keyed_take(plink, obj_idx, &sMessage);
+
+            if(lane_idx == APIPC_MAX_LANE)
+                continue;
+
+            apipc_message_recv(&plink->lane[lane_idx], &sMessage);
+            nmsg++;
+        }
     }
 
-    /* request ipc driver write */
-    IPCLtoRSendMessage(&g_sIpcController2,(uint32_t) APIPC_MESSAGE,
-            (uint32_t) urAddess, ulDataW1, ulDataW2, DISABLE_BLOCKING);
+    return nmsg;
 }
 
-/* apipc_message_handler - handle the received messege */
-static void apipc_message_handler (tIpcMessage *psMessage)
+/* apipc_keyed_flush - apply the pending keyed writes received on a lane before
+ * its seq queued message, so they keep their order with it, up to max_msgs.
+ * Returns the number applied */
+static uint16_t apipc_keyed_flush(struct apipc_lane *plane, uint16_t seq,
+                                  uint16_t max_msgs)
 {
-    enum apipc_msg_cmd ulCommand;
+    tIpcMessage sMessage;
+    uint16_t obj_idx;
+    uint16_t nmsg;
+    struct apipc_link *plink;
 
-    uint16_t obj_idx = 0;
-    uint16_t *pusRAddress;
+    nmsg = 0;
+    plink = plane->plink;
 
-    struct apipc_obj *plobj;
-    struct apipc_obj *probj;
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ && plink->key_pending &&
+                     nmsg < max_msgs; obj_idx++)
+    {
+        /* marks may wrap */
+        if(plink->key_lane[obj_idx] != plane->id ||
+           (int16_t)(seq - plink->key_mark[obj_idx]) <= 0)
+            continue;
 
-    /* initialize local variables */
-    plobj = &l_apipc_obj[obj_idx];
-    probj = &r_apipc_obj[obj_idx];
+        if(apipc_keyed_take(plink, obj_idx, &sMessage) == APIPC_MAX_LANE)
+            continue;
 
-    pusRAddress = (uint16_t *) psMessage->uladdress;
-    ulCommand = (enum apipc_msg_cmd) psMessage->uldataw1;
+        apipc_message_recv(plane, &sMessage);
+        nmsg++;
+    }
 
-    /* search the obj_idx corresponding to the response */
-    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; plobj++, probj++, obj_idx++)
-        if(pusRAddress == probj->paddr)
-            break;
+    return nmsg;
+}
 
-    /* take actions according to the received ipc command */
-    switch(ulCommand)
+/* apipc_keyed_take - take the pending keyed write of an obj off his slot,
+ * returns the lane it came on or APIPC_MAX_LANE if none is pending */
+static uint16_t apipc_keyed_take(struct apipc_link *plink, uint16_t obj_idx,
+                                 tIpcMessage *psMessage)
+{
+    uint16_t lane_idx;
+    uint16_t key;
+
+    /* slot is released before applying, a newer write lands again */
+    key = __disable_interrupts();
+
+    lane_idx = plink->key_lane[obj_idx];
+
+    if(lane_idx != APIPC_MAX_LANE)
     {
-        case APIPC_MSG_CMD_FUNC_CALL_RSP:
-        	pusRAddress = probj->paddr;
-            break;
+        *psMessage = plink->rx_key[obj_idx];
+        plink->key_lane[obj_idx] = APIPC_MAX_LANE;
+        plink->key_pending--;
+    }
 
-        case APIPC_MSG_CMD_SET_BITS_RSP:
-        case APIPC_MSG_CMD_CLEAR_BITS_RSP:
-        case APIPC_MSG_CMD_DATA_WRITE_RSP:
-        case APIPC_MSG_CMD_BLOCK_READ_RSP:
-            break;
+    __restore_interrupts(key);
 
-        case APIPC_MSG_CMD_BLOCK_WRITE_RSP:
-            if(plobj->pGSxM)
-            {
-                myfree(l_r_w_data_h, plobj->pGSxM);
-                plobj->pGSxM = NULL;
-            }
-            break;
+    return lane_idx;
+}
 
-        case APIPC_MSG_CMD_DATA_READ_PROTECTED_RSP:
-        case APIPC_MSG_CMD_SET_BITS_PROTECTED_RSP:
-        case APIPC_MSG_CMD_CLEAR_BITS_PROTECTED_RSP:
-        case APIPC_MSG_CMD_DATA_WRITE_PROTECTED_RSP:
-        case APIPC_MSG_CMD_BLOCK_WRITE_PROTECTED_RSP:
-            break;
+/* apipc_probe_put - stamp & put a latency probe */
+static enum apipc_rc apipc_probe_put(struct apipc_link *plink,
+                                     enum apipc_lane_id lane)
+{
+    struct apipc_probe *pprobe;
+    struct apipc_lane *plane;
+
+    pprobe = &plink->probe;
+    plane = apipc_lane_pick(plink, lane);
+
+    if(plane->inflight >= APIPC_LANE_BUDGET)
+        return APIPC_RC_BUSY;
+
+    if(apipc_lane_held(plane))
+    {
+        plane->stats.tx_held++;
+        return APIPC_RC_BUSY;
     }
-    
-    /* evolve obj sm */
-    switch (plobj->obj_sm)
+
+    pprobe->seq++;
+    pprobe->timer = ipc_read_timer();
+    pprobe->tx_stamp = (uint32_t)pprobe->timer;
+
+    if(STATUS_FAIL == apipc_put(plane, APIPC_PROBE, (uint32_t)pprobe->seq,
+                                pprobe->tx_stamp, 0, APIPC_PUT_URGENT))
     {
-        case APIPC_OBJ_SM_IDLE:
-            break;
+        plane->stats.tx_fail++;
+        return APIPC_RC_FAIL;
+    }
 
-        case APIPC_OBJ_SM_WAITTING_RESPONSE:
-            plobj->obj_sm = APIPC_OBJ_SM_IDLE;
-            break;
+    plane->stats.tx_cmd++;
+    pprobe->busy = 1;
+    pprobe->tx_lane = plane->id;
+    pprobe->stats.sent++;
 
-        default:
-            plobj->obj_sm = APIPC_OBJ_SM_UNKNOWN;
-            break;
+    /* the echo is a response, the probe holds a lane slot until then */
+    apipc_lane_take(plane);
+
+    return APIPC_RC_SUCCESS;
+}
+
+/* apipc_probe_stamp - stamp a probe or probe echo on arrival. Runs on the lane
+ * ISR, or from apipc_poll() on APIPC_POLLED builds */
+static void apipc_probe_stamp(struct apipc_lane *plane, tIpcMessage *psMessage)
+{
+    if(psMessage->ulcommand == APIPC_PROBE)
+        psMessage->uldataw2 = (uint32_t)ipc_read_timer();
+
+    else if(psMessage->ulcommand == APIPC_PROBE_ECHO)
+    {
+        plane->plink->probe.rx_stamp = (uint32_t)ipc_read_timer();
+        plane->plink->probe.rx_seq = (uint16_t)psMessage->uladdress;
     }
 }
 
-/* apipc_app - apipc application */
-void apipc_app(void)
+/* apipc_probe_echo - echo a received probe with his remote stamps */
+static void apipc_probe_echo(struct apipc_lane *plane, tIpcMessage *psMessage)
 {
-    static enum apipc_sm apipc_app_sm = APIPC_SM_UNKNOWN;
+    if(STATUS_FAIL == apipc_put(plane, APIPC_PROBE_ECHO, psMessage->uladdress,
+                                psMessage->uldataw2, (uint32_t)ipc_read_timer(),
+                                APIPC_PUT_RSP))
+        plane->stats.tx_fail++;
+    else
+        plane->stats.tx_rsp++;
+}
 
-    static struct apipc_obj *plobj;
-    uint16_t obj_idx;
+/* apipc_probe_done - account the legs of an echoed probe */
+static void apipc_probe_done(struct apipc_link *plink, tIpcMessage *psMessage)
+{
+    struct apipc_probe *pprobe;
+    struct apipc_probe_dist *pleg;
+    uint16_t seq;
+
+    pprobe = &plink->probe;
+    seq = (uint16_t)psMessage->uladdress;
+
+    /* echo of a probe already counted lost */
+    if(!pprobe->busy || seq != pprobe->seq || seq != pprobe->rx_seq)
+        return;
+
+    pprobe->busy = 0;
+    apipc_lane_give(&plink->lane[pprobe->tx_lane], 1);
+    pprobe->stats.done++;
+    pleg = pprobe->stats.leg;
+
+    apipc_probe_sample(&pleg[APIPC_PROBE_LEG_ISR],
+                       psMessage->uldataw1 - pprobe->tx_stamp);
+    apipc_probe_sample(&pleg[APIPC_PROBE_LEG_QUEUE],
+                       psMessage->uldataw2 - psMessage->uldataw1);
+    apipc_probe_sample(&pleg[APIPC_PROBE_LEG_ECHO],
+                       pprobe->rx_stamp - psMessage->uldataw2);
+    apipc_probe_sample(&pleg[APIPC_PROBE_LEG_RTT],
+                       pprobe->rx_stamp - pprobe->tx_stamp);
+}
 
-    plobj = l_apipc_obj;
+/* apipc_probe_sample - add a latency to a distribution */
+static void apipc_probe_sample(struct apipc_probe_dist *pdist, uint32_t ticks)
+{
+    uint16_t bucket;
+    uint32_t rest;
 
-    apipc_process_messages();
+    if(ticks < pdist->min)
+        pdist->min = ticks;
 
-    switch(apipc_app_sm)
+    if(ticks > pdist->max)
+        pdist->max = ticks;
+
+    pdist->last = ticks;
+    pdist->sum += ticks;
+
+    /* log2 bucket, the last one keeps every longer latency */
+    for(bucket = 0, rest = ticks; rest > 1 && bucket < APIPC_PROBE_BUCKETS - 1; bucket++)
+        rest >>= 1;
+
+    pdist->hist[bucket]++;
+}
+
+/* apipc_probe_reset - clear a probe statistics */
+static void apipc_probe_reset(struct apipc_probe *pprobe)
+{
+    uint16_t leg;
+
+    memset(&pprobe->stats, 0, sizeof(pprobe->stats));
+
+    for(leg = 0; leg < APIPC_PROBE_LEGS; leg++)
+        pprobe->stats.leg[leg].min = 0xFFFFFFFF;
+}
+
+/* apipc_probe_proc - give up lost probes and put the monitor ones */
+static void apipc_probe_proc(void)
+{
+    uint16_t link_idx;
+    struct apipc_link *plink;
+    struct apipc_probe *pprobe;
+
+    plink = apipc_links;
+
+    for(link_idx = 0; link_idx < APIPC_MAX_LINK; link_idx++, plink++)
     {
-        case APIPC_SM_UNKNOWN:
-            if(IPCRtoLFlagBusy(APIPC_FLAG_API_INITED) && IPCLtoRFlagBusy(APIPC_FLAG_API_INITED))
-#if defined( CPU2 )
-                if(IPCRtoLFlagBusy(APIPC_FLAG_APP_START))
-#endif
-                    apipc_app_sm = APIPC_SM_STARTUP_REMOTE;
-            break;
+        if(plink->l_obj == NULL)
+            continue;
 
-        case APIPC_SM_STARTUP_REMOTE:
-            if(!apipc_startup_remote())
-            {
-                apipc_app_sm = APIPC_SM_STARTED;
-                IPCLtoRFlagSet(APIPC_FLAG_APP_START);
-            }
-            break;
+        pprobe = &plink->probe;
 
-        case APIPC_SM_STARTED:
+        if(pprobe->busy && ipc_timer_expired(pprobe->timer, APIPC_PROBE_TIMEOUT))
+        {
+            pprobe->busy = 0;
+            apipc_lane_give(&plink->lane[pprobe->tx_lane], 1);
+            pprobe->stats.lost++;
+        }
+
+        if(pprobe->period && !pprobe->busy &&
+           ipc_timer_expired(pprobe->timer, pprobe->period))
+            apipc_probe_put(plink, pprobe->lane);
+    }
+}
 
-            for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++, plobj++)
-                apipc_proc_obj(plobj);
+/* apipc_inline_apply - unpack an inline write on the local obj it addresses */
+static void apipc_inline_apply(struct apipc_link *plink, tIpcMessage *psMessage)
+{
+    struct apipc_obj *plobj;
+    uint16_t usWords[APIPC_INLINE_WORDS];
+    uint16_t obj_idx;
 
-            break;
+    plobj = plink->l_obj;
 
-        case APIPC_SM_IDLE:
-            break;
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++, plobj++)
+    {
+        if(plobj->type != APIPC_OBJ_TYPE_INLINE ||
+           plobj->paddr != (void *)(uintptr_t)psMessage->uladdress)
+            continue;
+
+        usWords[0] = (uint16_t)psMessage->uldataw1;
+        usWords[1] = (uint16_t)(psMessage->uldataw1 >> 16);
+        usWords[2] = (uint16_t)psMessage->uldataw2;
+        usWords[3] = (uint16_t)(psMessage->uldataw2 >> 16);
+
+        u16memcpy(plobj->paddr, usWords, plobj->len);
+        apipc_rx_landed(obj_idx);
+
+        return;
     }
+}
+
+/* apipc_lease_slot - retrieve a free slot to lend a staging space, or
+ * APIPC_LEASE_MAX if every one is lent */
+static uint16_t apipc_lease_slot(struct apipc_link *plink)
+{
+    uint16_t slot;
+
+    for(slot = 0; slot < APIPC_LEASE_MAX; slot++)
+        if(plink->lent[slot] == NULL)
+            break;
 
+    return slot;
 }
 
-/* apipc_startup_remote - Initialize local object data on the remote core */
-enum apipc_rc apipc_startup_remote(void)
+/* apipc_lease_land - keep a lent staging space as the newest block of his
+ * obj. If the obj isn't leased anymore it is copied and given back */
+static void apipc_lease_land(struct apipc_link *plink, tIpcMessage *psMessage)
 {
-    enum apipc_rc rc;
     struct apipc_obj *plobj;
     uint16_t obj_idx;
+    uint16_t gen;
+    uint16_t fresh_gen = 0;
+    tIpcMessage sCopy;
 
-    plobj = l_apipc_obj;
-    rc = APIPC_RC_SUCCESS;
+    plobj = plink->l_obj;
+    gen = APIPC_LEASE_GEN(psMessage->uldataw1);
 
     for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++, plobj++)
+        if(plobj->paddr != NULL && plobj->paddr == (void *)(uintptr_t)psMessage->uladdress)
+            break;
+
+    /* a retransmition of a block already landed is only answered, the
+     * staging space may be lent again on a newer generation meanwhile */
+    if(obj_idx < APIPC_MAX_OBJ)
     {
-        apipc_proc_obj(plobj);
+        if((int16_t)(gen - apipc_ctl.rx_gen[obj_idx]) <= 0)
+            return;
 
-        if(plobj->obj_sm != APIPC_OBJ_SM_FREE && plobj->obj_sm != APIPC_OBJ_SM_IDLE)
-        	rc = APIPC_RC_FAIL;
+        fresh_gen = apipc_ctl.rx_gen[obj_idx];
+        apipc_ctl.rx_gen[obj_idx] = gen;
     }
 
-    return rc;
+    if(obj_idx == APIPC_MAX_OBJ || !(plobj->flags & APIPC_OBJ_LEASE))
+    {
+        sCopy = *psMessage;
+        sCopy.uldataw1 = ((uint32_t)IPC_LENGTH_16_BITS << 16) |
+                         APIPC_LEASE_LEN(psMessage->uldataw1);
+
+        IPCRtoLBlockWrite(&sCopy);
+        apipc_lease_return(plink, (uint16_t *)(uintptr_t)psMessage->uldataw2, gen);
+        apipc_rx_notify(plink, psMessage);
+        return;
+    }
+
+    /* a block never acquired is replaced by the newer one */
+    if(apipc_ctl.pfresh[obj_idx] != NULL)
+        apipc_lease_return(plink, apipc_ctl.pfresh[obj_idx], fresh_gen);
+
+    apipc_ctl.pfresh[obj_idx] = (uint16_t *)(uintptr_t)psMessage->uldataw2;
+    apipc_rx_landed(obj_idx);
 }
 
-/* apipc_process_messages - apipc interacs here with ipc driver on received
- * messages and take action according to the command */
-static enum apipc_rc apipc_process_messages(void)
+/* apipc_lease_return - queue a peer staging space to be given back */
+static void apipc_lease_return(struct apipc_link *plink, uint16_t *p,
+                               uint16_t gen)
 {
-    enum apipc_rc rc;
-    tIpcMessage sMessage;
+    uint16_t slot;
 
-    rc = APIPC_RC_SUCCESS;
+    /* the peer never lends more than APIPC_LEASE_MAX spaces, see
+     * APIPC_LEASE_RET */
+    for(slot = 0; slot < APIPC_LEASE_RET; slot++)
+        if(plink->lret[slot] == NULL)
+        {
+            plink->lret[slot] = p;
+            plink->lret_gen[slot] = gen;
+            plink->lret_put[slot] = 0;
+            break;
+        }
+
+    apipc_lease_proc();
+}
+
+/* apipc_lease_free - free a staging space the peer gave back. A repeated
+ * release finds nothing to free, it is answered anyway */
+static void apipc_lease_free(struct apipc_link *plink, tIpcMessage *psMessage)
+{
+    uint16_t slot;
+    uint16_t obj_idx;
 
-    if(!circular_buffer_pop(message_cbh, (void *)&sMessage))
+    for(slot = 0; slot < APIPC_LEASE_MAX; slot++)
+        if(plink->lent[slot] != NULL &&
+           plink->lent[slot] == (uint16_t *)(uintptr_t)psMessage->uladdress &&
+           plink->lent_gen[slot] == (uint16_t)psMessage->uldataw1)
+            break;
+
+    if(slot == APIPC_LEASE_MAX)
+        return;
+
+    /* the peer got the block even if his lease write response was lost */
+    for(obj_idx = 0; obj_idx < APIPC_MAX_OBJ; obj_idx++)
     {
-        switch(sMessage.ulcommand) 
+        if(apipc_ctl.lease[obj_idx] != slot || APIPC_OBJ_LINK(obj_idx) != plink)
+            continue;
+
+        apipc_ctl.pGSxM[obj_idx] = NULL;
+        apipc_ctl.lease[obj_idx] = APIPC_LEASE_MAX;
+
+        if(apipc_ctl.obj_sm[obj_idx] == APIPC_OBJ_SM_WAITTING_RESPONSE)
         {
-            case IPC_FUNC_CALL:
-                IPCRtoLFunctionCall(&sMessage);
-                apipc_cmd_response(&sMessage);
-                break;
+            apipc_obj_release(obj_idx);
+            apipc_obj_done(obj_idx);
+        }
+    }
 
-            case IPC_DATA_WRITE:
-                IPCRtoLDataWrite(&sMessage);
-                apipc_cmd_response (&sMessage);
-                break;
+    apipc_stage_free(plink->lent[slot]);
+    plink->lent[slot] = NULL;
+}
 
-            case IPC_BLOCK_READ:
-                IPCRtoLBlockRead(&sMessage);
-                apipc_cmd_response (&sMessage);
-                break;
+/* apipc_lease_acked - the peer freed a staging space given back, the release
+ * gives his lane slot back */
+static void apipc_lease_acked(struct apipc_link *plink, tIpcMessage *psMessage)
+{
+    uint16_t slot;
 
-            case IPC_BLOCK_WRITE:
-                IPCRtoLBlockWrite(&sMessage);
-                apipc_cmd_response (&sMessage);
-                break;
+    for(slot = 0; slot < APIPC_LEASE_RET; slot++)
+        if(plink->lret[slot] != NULL && plink->lret_put[slot] &&
+           plink->lret[slot] == (uint16_t *)(uintptr_t)psMessage->uladdress &&
+           plink->lret_gen[slot] == (uint16_t)psMessage->uldataw2)
+        {
+            apipc_lane_give(&plink->lane[plink->lret_lane[slot]], 1);
+            plink->lret_put[slot] = 0;
+            plink->lret[slot] = NULL;
+            return;
+        }
+}
 
-            case IPC_SET_BITS:
-                IPCRtoLSetBits(&sMessage);
-                apipc_cmd_response (&sMessage);
-                break;
+/* apipc_lease_drop - free the staging a failed obj lent, the peer may never
+ * give it back */
+static void apipc_lease_drop(uint16_t obj_idx)
+{
+    struct apipc_link *plink;
+    uint16_t slot;
 
-            case IPC_CLEAR_BITS:
-                IPCRtoLClearBits(&sMessage);
-                apipc_cmd_response (&sMessage);
-                break;
+    slot = apipc_ctl.lease[obj_idx];
+
+    if(slot == APIPC_LEASE_MAX)
+        return;
+
+    plink = APIPC_OBJ_LINK(obj_idx);
+
+    apipc_stage_free(plink->lent[slot]);
+    plink->lent[slot] = NULL;
+    apipc_ctl.pGSxM[obj_idx] = NULL;
+    apipc_ctl.lease[obj_idx] = APIPC_LEASE_MAX;
+}
+
+/* apipc_lease_proc - give back the queued peer staging spaces */
+static void apipc_lease_proc(void)
+{
+    uint16_t link_idx;
+    uint16_t slot;
+    struct apipc_link *plink;
+    struct apipc_lane *plane;
+
+    plink = apipc_links;
+
+    for(link_idx = 0; link_idx < APIPC_MAX_LINK; link_idx++, plink++)
+    {
+        if(plink->l_obj == NULL)
+            continue;
+
+        for(slot = 0; slot < APIPC_LEASE_RET; slot++)
+        {
+            if(plink->lret[slot] == NULL)
+                continue;
+
+            /* a release waits his response, lost ones are put again */
+            if(plink->lret_put[slot])
+            {
+                if(!ipc_timer_expired(plink->lret_timer[slot], IPC_TIMER_WAIT_5mS))
+                    continue;
+
+                plane = &plink->lane[plink->lret_lane[slot]];
+                plane->stats.timeout++;
+                apipc_lane_give(plane, 1);
+                plink->lret_put[slot] = 0;
+            }
+
+            plane = apipc_lane_pick(plink, APIPC_LANE_AUTO);
 
-            case APIPC_MESSAGE:
-                apipc_message_handler(&sMessage);
+            /* tried again on the next apipc_app(), later links are served
+             * meanwhile */
+            if(plane->inflight >= APIPC_LANE_BUDGET || apipc_lane_held(plane))
                 break;
 
-            default:
-                rc = APIPC_RC_FAIL;
+            if(STATUS_FAIL == apipc_put(plane, APIPC_LEASE_RELEASE,
+                                        (uint32_t)(uintptr_t)plink->lret[slot],
+                                        plink->lret_gen[slot], 0, APIPC_PUT_CMD))
+            {
+                plane->stats.tx_fail++;
                 break;
+            }
+
+            /* the release holds a lane slot until its response */
+            plink->lret_put[slot] = 1;
+            plink->lret_lane[slot] = plane->id;
+            plink->lret_timer[slot] = ipc_read_timer();
+            plane->stats.tx_cmd++;
+
+            apipc_lane_take(plane);
         }
     }
-    return rc;
+}
+
+/* apipc_keyed_apply - write a keyed write value on the local obj */
+static void apipc_keyed_apply(tIpcMessage *psMessage)
+{
+    if(APIPC_KEYED_LEN(psMessage->uldataw1) == IPC_LENGTH_16_BITS)
+        *(uint16_t *)(uintptr_t)psMessage->uladdress = (uint16_t)psMessage->uldataw2;
+    else
+        *(uint32_t *)(uintptr_t)psMessage->uladdress = psMessage->uldataw2;
 }
 
 #if defined( CPU1 )
@@ -717,29 +4393,16 @@ static enum apipc_rc apipc_process_messages(void)
 #endif
 
 //
-// RtoLIPC0IntHandler - Handler writes into CPU01 addesses as a result of
-// read commands to CPU02.
+// RtoLIPC0IntHandler - Handles messages received on IPC_INT0 lane
+//
 interrupt void apipc_ipc0_isr_handler(void)
 {
-    tIpcMessage sMessage;
-
     //
-    // Continue processing messages as long as CPU01 to CPUE02
-    // GetBuffer1 if full
+    // Get messages from driver as long as GetBuffer1 is full and store on the
+    // lane circullar buffer to be processed
     //
-    while(IpcGet(&g_sIpcController1, &sMessage,
-		DISABLE_BLOCKING) != STATUS_FAIL)
-    {
-	switch(sMessage.ulcommand)
-	{
-	    case IPC_DATA_WRITE:
-		IPCRtoLDataWrite(&sMessage);
-		break;
-	    default:
-		break;
-	}	
+    apipc_lane_drain(&apipc_links[APIPC_LINK_0].lane[APIPC_LANE_0]);
 
-    }
     /* Acknowledge IC INT0 Flag */
     IpcRegs.IPCACK.bit.IPC0 = 1;
 
@@ -748,17 +4411,15 @@ interrupt void apipc_ipc0_isr_handler(void)
 }
 
 //
-// RtoLIPC1IntHandler - Handles Data Block Reads/Writes
+// RtoLIPC1IntHandler - Handles messages received on IPC_INT1 lane
 // 
 interrupt void apipc_ipc1_isr_handler(void)
 {
-    tIpcMessage sMessage;
     //
     // Get messages from driver as long as GetBuffer2 is full and store on the
-    // apipc circullar buffer to be processed
+    // lane circullar buffer to be processed
     //
-    while(IpcGet(&g_sIpcController2, &sMessage, DISABLE_BLOCKING)!= STATUS_FAIL)
-        circular_buffer_put(message_cbh, (void *)&sMessage);
+    apipc_lane_drain(&apipc_links[APIPC_LINK_0].lane[APIPC_LANE_1]);
 
     /* Acknowledge IC INT1 Flag */
     IpcRegs.IPCACK.bit.IPC1 = 1;
@@ -767,6 +4428,17 @@ interrupt void apipc_ipc1_isr_handler(void)
     PieCtrlRegs.PIEACK.all = PIEACK_GROUP1;
 }
 
+//
+// RtoLIPC2IntHandler - Dispatches the remote mailbox message
+//
+interrupt void apipc_ipc2_isr_handler(void)
+{
+    apipc_mbox_dispatch();
+
+    /* acknowledge the PIE group interrupt. */
+    PieCtrlRegs.PIEACK.all = PIEACK_GROUP1;
+}
+
 //
 // End of the file.
 //
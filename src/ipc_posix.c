@@ -0,0 +1,604 @@
+/**
+ *
+ * \file ipc_posix.c
+ *
+ * \brief POSIX shared memory IPC driver implementation.
+ *
+ * \author Federico David Ceccarelli
+ *
+ * Only built on apipc host builds, APIPC_POSIX=1. See ipc_posix.h.
+ *
+ */
+
+#if APIPC_POSIX
+
+#define _GNU_SOURCE
+
+#include "ipc_posix.h"
+#include "ipc_utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0 /**< IPC_POSIX_BASE is checked after mapping */
+#endif
+
+/** ring index wrap mask */
+#define IPC_POSIX_RING_MASK (IPC_BUFFER_SIZE - 1)
+
+/** interrupt thread futex wait, lets ipc_posix_close() stop it */
+#define IPC_POSIX_IRQ_WAIT_NS 10000000L
+
+/** emulated registers. */
+volatile struct IPC_REGS IpcRegs;
+volatile struct PIE_CTRL_REGS PieCtrlRegs;
+
+/** interrupt thread, handlers & the lock __disable_interrupts() takes. */
+static pthread_t irq_thread;
+static pthread_mutex_t irq_lock;
+static void (*irq_handlers[IPC_POSIX_MAX_INT])(void);
+static volatile int irq_stop;
+
+/** shared memory object name, CPU1 removes it on close. */
+static char shm_name[64];
+
+/** statics functions prototipes declarations
+* @{*/
+static void ipc_posix_wake(struct ipc_posix_core *pcore);
+static uint16_t ipc_posix_irq_enabled(uint16_t n);
+static void *ipc_posix_irq_proc(void *arg);
+/** @}*/
+
+/* ipc_posix_open: map the shared memory segment */
+int ipc_posix_open(const char *name)
+{
+    pthread_mutexattr_t attr;
+    struct stat st;
+    void *p;
+    int fd;
+
+    strncpy(shm_name, name, sizeof(shm_name) - 1);
+
+#if defined(CPU1)
+    /* a segment left by a previous run is never reused */
+    shm_unlink(name);
+
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0)
+        return -1;
+
+    if(ftruncate(fd, sizeof(struct ipc_posix_shm)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+#else
+    fd = shm_open(name, O_RDWR, 0600);
+    if(fd < 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct ipc_posix_shm))
+    {
+        close(fd);
+        errno = EAGAIN;
+        return -1;
+    }
+#endif
+    (void)st;
+
+    p = mmap((void *)IPC_POSIX_BASE, sizeof(struct ipc_posix_shm),
+             PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    close(fd);
+
+    if(p == MAP_FAILED)
+        return -1;
+
+    /* addresses travel between processes, the segment must be on the same
+     * place on both */
+    if(p != (void *)IPC_POSIX_BASE)
+    {
+        munmap(p, sizeof(struct ipc_posix_shm));
+        errno = EADDRINUSE;
+        return -1;
+    }
+
+#if defined(CPU1)
+    memset(p, 0, sizeof(struct ipc_posix_shm));
+    __atomic_store_n(&IPC_POSIX_SHM->magic, IPC_POSIX_MAGIC, __ATOMIC_RELEASE);
+#else
+    if(__atomic_load_n(&IPC_POSIX_SHM->magic, __ATOMIC_ACQUIRE) != IPC_POSIX_MAGIC)
+    {
+        munmap(p, sizeof(struct ipc_posix_shm));
+        errno = EAGAIN;
+        return -1;
+    }
+#endif
+
+    /* handlers nest as the PIE does, the lock is recursive */
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&irq_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    irq_stop = 0;
+
+    if(pthread_create(&irq_thread, NULL, ipc_posix_irq_proc, NULL) != 0)
+    {
+        munmap(p, sizeof(struct ipc_posix_shm));
+        return -1;
+    }
+
+    return 0;
+}
+
+/* ipc_posix_close: stop the interrupt thread and unmap the segment */
+void ipc_posix_close(void)
+{
+    __atomic_store_n(&irq_stop, 1, __ATOMIC_RELEASE);
+    ipc_posix_wake(&IPC_POSIX_SHM->core[IPC_POSIX_LOCAL]);
+    pthread_join(irq_thread, NULL);
+
+    munmap((void *)IPC_POSIX_BASE, sizeof(struct ipc_posix_shm));
+
+#if defined(CPU1)
+    shm_unlink(shm_name);
+#endif
+}
+
+/* ipc_posix_isr: register an IPC interrupt handler */
+void ipc_posix_isr(uint16_t ipc_int, void (*handler)(void))
+{
+    if(ipc_int < IPC_INT0 || ipc_int > IPC_INT3)
+        return;
+
+    __atomic_store_n(&irq_handlers[ipc_int - IPC_INT0], handler, __ATOMIC_RELEASE);
+}
+
+/* ipc_posix_counter: read the emulated IPCCOUNTER */
+uint64_t ipc_posix_counter(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    /* 200MHz, 5nS a tick */
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) / 5;
+}
+
+/* ipc_posix_wake: raise a core interrupt */
+static void ipc_posix_wake(struct ipc_posix_core *pcore)
+{
+    __atomic_add_fetch(&pcore->irq, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &pcore->irq, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/* ipc_posix_irq_enabled: consult the PIEIER1 bit of an IPC interrupt */
+static uint16_t ipc_posix_irq_enabled(uint16_t n)
+{
+    switch(n)
+    {
+        case 0: return PieCtrlRegs.PIEIER1.bit.INTx13;
+        case 1: return PieCtrlRegs.PIEIER1.bit.INTx14;
+        case 2: return PieCtrlRegs.PIEIER1.bit.INTx15;
+        case 3: return PieCtrlRegs.PIEIER1.bit.INTx16;
+    }
+    return 0;
+}
+
+/* ipc_posix_irq_proc: interrupt thread. Handlers run once a flag is set, as
+ * on the rising edge, and are run again only after it was acknowledged */
+static void *ipc_posix_irq_proc(void *arg)
+{
+    struct ipc_posix_core *pcore;
+    struct timespec wait;
+    void (*handler)(void);
+    uint32_t served;
+    uint32_t flg;
+    uint32_t seq;
+    uint32_t ack;
+    uint16_t n;
+
+    (void)arg;
+    pcore = &IPC_POSIX_SHM->core[IPC_POSIX_LOCAL];
+    served = 0;
+    wait.tv_sec = 0;
+    wait.tv_nsec = IPC_POSIX_IRQ_WAIT_NS;
+
+    while(!__atomic_load_n(&irq_stop, __ATOMIC_ACQUIRE))
+    {
+        seq = __atomic_load_n(&pcore->irq, __ATOMIC_ACQUIRE);
+        flg = __atomic_load_n(&pcore->flg, __ATOMIC_ACQUIRE);
+
+        /* acknowledged flags raise the interrupt again */
+        served &= flg;
+
+        for(n = 0; n < IPC_POSIX_MAX_INT; n++)
+        {
+            handler = __atomic_load_n(&irq_handlers[n], __ATOMIC_ACQUIRE);
+
+            if(!(flg & (1UL << n)) || (served & (1UL << n)) ||
+               handler == NULL || !ipc_posix_irq_enabled(n))
+                continue;
+
+            served |= 1UL << n;
+
+            pthread_mutex_lock(&irq_lock);
+
+            handler();
+
+            ack = IpcRegs.IPCACK.all;
+            IpcRegs.IPCACK.all = 0;
+            __atomic_and_fetch(&pcore->flg, ~ack, __ATOMIC_ACQ_REL);
+
+            /* a flag set again after the acknowledge is a new edge */
+            served &= ~ack;
+
+            pthread_mutex_unlock(&irq_lock);
+        }
+
+        syscall(SYS_futex, &pcore->irq, FUTEX_WAIT, seq, &wait, NULL, 0);
+    }
+
+    return NULL;
+}
+
+/* __disable_interrupts: keep handlers out */
+uint16_t __disable_interrupts(void)
+{
+    pthread_mutex_lock(&irq_lock);
+    return 1;
+}
+
+/* __restore_interrupts: let handlers in again */
+void __restore_interrupts(uint16_t key)
+{
+    (void)key;
+    pthread_mutex_unlock(&irq_lock);
+}
+
+#if defined(CPU1)
+/* GSxM_Acces: the whole segment is shared R/W, nothing to configure */
+void GSxM_Acces(uint32_t ulMask, uint16_t usMaster)
+{
+    (void)ulMask;
+    (void)usMaster;
+}
+#endif
+
+/* InitIpc: CPU1 already created a clean segment, flags are kept */
+void InitIpc(void)
+{
+}
+
+/* IPCInitialize: bind a controller to the put & get rings of its interrupts */
+void IPCInitialize(volatile tIpcController *psController,
+                   uint16_t usCPU2IpcInterrupt, uint16_t usCPU1IpcInterrupt)
+{
+    struct ipc_posix_ring *pput;
+    struct ipc_posix_ring *pget;
+    uint16_t put_int;
+    uint16_t get_int;
+
+#if defined(CPU1)
+    put_int = usCPU2IpcInterrupt;
+    get_int = usCPU1IpcInterrupt;
+#else
+    put_int = usCPU1IpcInterrupt;
+    get_int = usCPU2IpcInterrupt;
+#endif
+
+    pput = &IPC_POSIX_SHM->core[IPC_POSIX_REMOTE].ring[put_int - IPC_INT0];
+    pget = &IPC_POSIX_SHM->core[IPC_POSIX_LOCAL].ring[get_int - IPC_INT0];
+
+    psController->psPutBuffer = pput->msg;
+    psController->ulPutFlag = 1UL << (put_int - IPC_INT0);
+    psController->pusPutWriteIndex = &pput->windex;
+    psController->pusPutReadIndex = &pput->rindex;
+    psController->psGetBuffer = pget->msg;
+    psController->pusGetWriteIndex = &pget->windex;
+    psController->pusGetReadIndex = &pget->rindex;
+
+    /* every core resets the indexes it writes */
+    __atomic_store_n(&pput->windex, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&pget->rindex, 0, __ATOMIC_RELEASE);
+}
+
+/* IpcPut: put a message on the controller put ring and interrupt the remote
+ * core */
+uint16_t IpcPut(volatile tIpcController *psController, tIpcMessage *psMessage,
+                uint16_t bBlock)
+{
+    if(IpcPutNoFlag(psController, psMessage, bBlock) == STATUS_FAIL)
+        return STATUS_FAIL;
+
+    IPCLtoRFlagSet(psController->ulPutFlag);
+
+    return STATUS_PASS;
+}
+
+/* IpcPutNoFlag: put a message on the controller put ring, the remote core is
+ * interrupted by the caller */
+uint16_t IpcPutNoFlag(volatile tIpcController *psController,
+                      tIpcMessage *psMessage, uint16_t bBlock)
+{
+    uint16_t windex;
+    uint16_t rindex;
+
+    windex = *psController->pusPutWriteIndex;
+
+    for(;;)
+    {
+        rindex = __atomic_load_n(psController->pusPutReadIndex, __ATOMIC_ACQUIRE);
+
+        if(((windex + 1) & IPC_POSIX_RING_MASK) != rindex)
+            break;
+
+        if(bBlock == DISABLE_BLOCKING)
+            return STATUS_FAIL;
+
+        sched_yield();
+    }
+
+    psController->psPutBuffer[windex] = *psMessage;
+    __atomic_store_n(psController->pusPutWriteIndex,
+                     (uint16_t)((windex + 1) & IPC_POSIX_RING_MASK), __ATOMIC_RELEASE);
+
+    return STATUS_PASS;
+}
+
+/* IpcPutFree: free slots of the controller put ring */
+uint16_t IpcPutFree(volatile tIpcController *psController)
+{
+    uint16_t windex;
+    uint16_t rindex;
+
+    windex = *psController->pusPutWriteIndex;
+    rindex = __atomic_load_n(psController->pusPutReadIndex, __ATOMIC_ACQUIRE);
+
+    return (uint16_t)((rindex - windex - 1) & IPC_POSIX_RING_MASK);
+}
+
+/* IpcGet: get a message from the controller get ring */
+uint16_t IpcGet(volatile tIpcController *psController, tIpcMessage *psMessage,
+                uint16_t bBlock)
+{
+    uint16_t windex;
+    uint16_t rindex;
+
+    rindex = *psController->pusGetReadIndex;
+
+    for(;;)
+    {
+        windex = __atomic_load_n(psController->pusGetWriteIndex, __ATOMIC_ACQUIRE);
+
+        if(windex != rindex)
+            break;
+
+        if(bBlock == DISABLE_BLOCKING)
+            return STATUS_FAIL;
+
+        sched_yield();
+    }
+
+    *psMessage = psController->psGetBuffer[rindex];
+    __atomic_store_n(psController->pusGetReadIndex,
+                     (uint16_t)((rindex + 1) & IPC_POSIX_RING_MASK), __ATOMIC_RELEASE);
+
+    return STATUS_PASS;
+}
+
+/* IPCLtoRDataWrite: request the remote core to write a 16/32 bits value */
+uint16_t IPCLtoRDataWrite(volatile tIpcController *psController,
+                          uint32_t ulAddress, uint32_t ulData, uint16_t usLength,
+                          uint16_t bBlock, uint32_t ulResponseFlag)
+{
+    tIpcMessage sMessage;
+
+    sMessage.ulcommand = IPC_DATA_WRITE;
+    sMessage.uladdress = ulAddress;
+    sMessage.uldataw1 = (ulResponseFlag & 0xFFFF0000) | (uint32_t)usLength;
+    sMessage.uldataw2 = ulData;
+
+    return IpcPut(psController, &sMessage, bBlock);
+}
+
+/* IPCLtoRSetBits: request the remote core to set bits of a 16/32 bits value */
+uint16_t IPCLtoRSetBits(volatile tIpcController *psController, uint32_t ulAddress,
+                        uint32_t ulMask, uint16_t usLength, uint16_t bBlock)
+{
+    tIpcMessage sMessage;
+
+    sMessage.ulcommand = IPC_SET_BITS;
+    sMessage.uladdress = ulAddress;
+    sMessage.uldataw1 = (uint32_t)usLength;
+    sMessage.uldataw2 = ulMask;
+
+    return IpcPut(psController, &sMessage, bBlock);
+}
+
+/* IPCLtoRClearBits: request the remote core to clear bits of a 16/32 bits
+ * value */
+uint16_t IPCLtoRClearBits(volatile tIpcController *psController, uint32_t ulAddress,
+                          uint32_t ulMask, uint16_t usLength, uint16_t bBlock)
+{
+    tIpcMessage sMessage;
+
+    sMessage.ulcommand = IPC_CLEAR_BITS;
+    sMessage.uladdress = ulAddress;
+    sMessage.uldataw1 = (uint32_t)usLength;
+    sMessage.uldataw2 = ulMask;
+
+    return IpcPut(psController, &sMessage, bBlock);
+}
+
+/* IPCLtoRBlockWrite: request the remote core to copy a block from shared
+ * memory */
+uint16_t IPCLtoRBlockWrite(volatile tIpcController *psController,
+                           uint32_t ulAddress, uint32_t ulShareAddress,
+                           uint16_t usLength, uint16_t usWLength, uint16_t bBlock)
+{
+    tIpcMessage sMessage;
+
+    sMessage.ulcommand = IPC_BLOCK_WRITE;
+    sMessage.uladdress = ulAddress;
+    sMessage.uldataw1 = ((uint32_t)usWLength << 16) | (uint32_t)usLength;
+    sMessage.uldataw2 = ulShareAddress;
+
+    return IpcPut(psController, &sMessage, bBlock);
+}
+
+/* IPCLtoRFunctionCall: request the remote core to call a function */
+uint16_t IPCLtoRFunctionCall(volatile tIpcController *psController,
+                             uint32_t ulAddress, uint32_t ulParam, uint16_t bBlock)
+{
+    tIpcMessage sMessage;
+
+    sMessage.ulcommand = IPC_FUNC_CALL;
+    sMessage.uladdress = ulAddress;
+    sMessage.uldataw1 = ulParam;
+    sMessage.uldataw2 = 0;
+
+    return IpcPut(psController, &sMessage, bBlock);
+}
+
+/* IPCLtoRSendMessage: put a user defined message */
+uint16_t IPCLtoRSendMessage(volatile tIpcController *psController,
+                            uint32_t ulCommand, uint32_t ulAddress,
+                            uint32_t ulDataW1, uint32_t ulDataW2, uint16_t bBlock)
+{
+    tIpcMessage sMessage;
+
+    sMessage.ulcommand = ulCommand;
+    sMessage.uladdress = ulAddress;
+    sMessage.uldataw1 = ulDataW1;
+    sMessage.uldataw2 = ulDataW2;
+
+    return IpcPut(psController, &sMessage, bBlock);
+}
+
+/* IPCRtoLDataWrite: serve an IPC_DATA_WRITE */
+void IPCRtoLDataWrite(tIpcMessage *psMessage)
+{
+    uint16_t usLength;
+
+    usLength = (uint16_t)psMessage->uldataw1;
+
+    if(usLength == IPC_LENGTH_16_BITS)
+        *(uint16_t *)(uintptr_t)psMessage->uladdress = (uint16_t)psMessage->uldataw2;
+    else if(usLength == IPC_LENGTH_32_BITS)
+        *(uint32_t *)(uintptr_t)psMessage->uladdress = psMessage->uldataw2;
+
+    if(psMessage->uldataw1 & 0xFFFF0000)
+        IPCLtoRFlagSet(psMessage->uldataw1 & 0xFFFF0000);
+}
+
+/* IPCRtoLSetBits: serve an IPC_SET_BITS */
+void IPCRtoLSetBits(tIpcMessage *psMessage)
+{
+    if((uint16_t)psMessage->uldataw1 == IPC_LENGTH_16_BITS)
+        *(uint16_t *)(uintptr_t)psMessage->uladdress |= (uint16_t)psMessage->uldataw2;
+    else if((uint16_t)psMessage->uldataw1 == IPC_LENGTH_32_BITS)
+        *(uint32_t *)(uintptr_t)psMessage->uladdress |= psMessage->uldataw2;
+}
+
+/* IPCRtoLClearBits: serve an IPC_CLEAR_BITS */
+void IPCRtoLClearBits(tIpcMessage *psMessage)
+{
+    if((uint16_t)psMessage->uldataw1 == IPC_LENGTH_16_BITS)
+        *(uint16_t *)(uintptr_t)psMessage->uladdress &= ~(uint16_t)psMessage->uldataw2;
+    else if((uint16_t)psMessage->uldataw1 == IPC_LENGTH_32_BITS)
+        *(uint32_t *)(uintptr_t)psMessage->uladdress &= ~psMessage->uldataw2;
+}
+
+/* IPCRtoLBlockRead: serve an IPC_BLOCK_READ, copy a local block to shared
+ * memory */
+void IPCRtoLBlockRead(tIpcMessage *psMessage)
+{
+    memcpy((void *)(uintptr_t)psMessage->uldataw2,
+           (const void *)(uintptr_t)psMessage->uladdress,
+           (size_t)(uint16_t)psMessage->uldataw1 * sizeof(uint16_t));
+
+    if(psMessage->uldataw1 & 0xFFFF0000)
+        IPCLtoRFlagSet(psMessage->uldataw1 & 0xFFFF0000);
+}
+
+/* IPCRtoLBlockWrite: serve an IPC_BLOCK_WRITE, copy a block from shared
+ * memory */
+void IPCRtoLBlockWrite(tIpcMessage *psMessage)
+{
+    size_t size;
+
+    size = ((psMessage->uldataw1 >> 16) == IPC_LENGTH_32_BITS) ?
+           sizeof(uint32_t) : sizeof(uint16_t);
+
+    memcpy((void *)(uintptr_t)psMessage->uladdress,
+           (const void *)(uintptr_t)psMessage->uldataw2,
+           (size_t)(uint16_t)psMessage->uldataw1 * size);
+}
+
+/* IPCRtoLFunctionCall: serve an IPC_FUNC_CALL */
+void IPCRtoLFunctionCall(tIpcMessage *psMessage)
+{
+    void (*fn)(uint32_t);
+
+    fn = (void (*)(uint32_t))(uintptr_t)psMessage->uladdress;
+    fn(psMessage->uldataw1);
+}
+
+/* IPCLtoRFlagSet: set flags on the remote core and interrupt it */
+void IPCLtoRFlagSet(uint32_t ulFlags)
+{
+    struct ipc_posix_core *pcore;
+
+    pcore = &IPC_POSIX_SHM->core[IPC_POSIX_REMOTE];
+
+    __atomic_or_fetch(&pcore->flg, ulFlags, __ATOMIC_ACQ_REL);
+    ipc_posix_wake(pcore);
+}
+
+/* IPCLtoRFlagClear: clear flags set on the remote core */
+void IPCLtoRFlagClear(uint32_t ulFlags)
+{
+    __atomic_and_fetch(&IPC_POSIX_SHM->core[IPC_POSIX_REMOTE].flg, ~ulFlags,
+                       __ATOMIC_ACQ_REL);
+}
+
+/* IPCLtoRFlagBusy: check if the remote core didn't acknowledge the flags yet */
+uint16_t IPCLtoRFlagBusy(uint32_t ulFlags)
+{
+    return (__atomic_load_n(&IPC_POSIX_SHM->core[IPC_POSIX_REMOTE].flg,
+                            __ATOMIC_ACQUIRE) & ulFlags) ? 1 : 0;
+}
+
+/* IPCRtoLFlagBusy: check if the remote core set the flags */
+uint16_t IPCRtoLFlagBusy(uint32_t ulFlags)
+{
+    return (__atomic_load_n(&IPC_POSIX_SHM->core[IPC_POSIX_LOCAL].flg,
+                            __ATOMIC_ACQUIRE) & ulFlags) ? 1 : 0;
+}
+
+/* IPCRtoLFlagAcknowledge: acknowledge flags set by the remote core */
+void IPCRtoLFlagAcknowledge(uint32_t ulFlags)
+{
+    __atomic_and_fetch(&IPC_POSIX_SHM->core[IPC_POSIX_LOCAL].flg, ~ulFlags,
+                       __ATOMIC_ACQ_REL);
+}
+
+#endif
+
+//
+// End of the file.
+//
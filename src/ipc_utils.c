@@ -8,11 +8,36 @@
  *
  */
 
+#if APIPC_POSIX
+#include "ipc_posix.h"
+#else
 #include "F2837xD_device.h"
 #include "F2837xD_Examples.h"
+#endif
 
 #include "ipc_utils.h"
 
+#if !defined(IPC_CRC32_KERNEL)
+/** portable CRC32 kernel slice-by-IPC_CRC32_SLICE lookup tables. */
+static uint32_t crc32_table[IPC_CRC32_SLICE][256];
+
+/** process one uint16_t, low byte first, on a running CRC32 */
+#define IPC_CRC32_WORD(crc, w) \
+    ((crc) = ((crc) ^ (uint16_t)(w)), \
+     (crc) = crc32_table[1][(crc) & 0xFF] ^ crc32_table[0][((crc) >> 8) & 0xFF] ^ \
+             ((crc) >> 16))
+
+#if IPC_CRC32_SLICE == 4
+/** process two uint16_t, w0 first, on a running CRC32 */
+#define IPC_CRC32_DWORD(crc, w0, w1) \
+    ((crc) = ((crc) ^ ((uint32_t)(uint16_t)(w0) | ((uint32_t)(uint16_t)(w1) << 16))), \
+     (crc) = crc32_table[3][(crc) & 0xFF] ^ crc32_table[2][((crc) >> 8) & 0xFF] ^ \
+             crc32_table[1][((crc) >> 16) & 0xFF] ^ crc32_table[0][((crc) >> 24) & 0xFF])
+#elif IPC_CRC32_SLICE != 2
+#error "IPC_CRC32_SLICE should be 2 or 4"
+#endif
+#endif
+
 /*
  * u16memcpy() - copies n uint16_t size memory blocks from s2 to s1  
  */
@@ -56,6 +81,9 @@
  */
 uint64_t ipc_read_timer(void)
 {
+#if APIPC_POSIX
+    return ipc_posix_counter();
+#else
     uint32_t low, high;
 
     /*
@@ -66,6 +94,7 @@ uint64_t ipc_read_timer(void)
     high = IpcRegs.IPCCOUNTERH;
 
     return ((uint64_t)high << 32) | (uint64_t)low;
+#endif
 }
 
 /*
@@ -91,7 +120,144 @@ uint16_t ipc_timer_expired(uint64_t start, uint64_t wait)
 
 }
 
-#if defined(CPU1)
+/*
+ * ipc_crc32_init - build the portable CRC32 kernel lookup tables
+ */
+void ipc_crc32_init(void)
+{
+#if !defined(IPC_CRC32_KERNEL)
+    uint32_t crc;
+    uint16_t idx;
+    uint16_t bit;
+    uint16_t slice;
+
+    for (idx = 0; idx < 256; idx++)
+    {
+        crc = idx;
+
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320UL : (crc >> 1);
+
+        crc32_table[0][idx] = crc;
+    }
+
+    /* every slice advances the previous one a byte further */
+    for (slice = 1; slice < IPC_CRC32_SLICE; slice++)
+        for (idx = 0; idx < 256; idx++)
+        {
+            crc = crc32_table[slice - 1][idx];
+            crc32_table[slice][idx] = (crc >> 8) ^ crc32_table[0][crc & 0xFF];
+        }
+#endif
+}
+
+/*
+ * ipc_crc32 - accumulate n uint16_t on a running CRC32
+ */
+uint32_t ipc_crc32(uint32_t crc, const uint16_t *p, size_t n)
+{
+#if defined(IPC_CRC32_KERNEL)
+    return IPC_CRC32_KERNEL(crc, p, n);
+#else
+#if IPC_CRC32_SLICE == 4
+    for (; n >= 2; n -= 2, p += 2)
+        IPC_CRC32_DWORD(crc, p[0], p[1]);
+#endif
+    for (; n; n--)
+        IPC_CRC32_WORD(crc, *p++);
+
+    return crc;
+#endif
+}
+
+/*
+ * ipc_crc32_copy - copy n uint16_t from s2 to s1 accumulating them on a
+ *                  running CRC32
+ */
+uint32_t ipc_crc32_copy(uint16_t * __restrict to, const uint16_t * __restrict from,
+                        size_t n, uint32_t crc)
+{
+#if defined(IPC_CRC32_KERNEL)
+    u16memcpy(to, from, n);
+    return IPC_CRC32_KERNEL(crc, to, n);
+#else
+    uint16_t w0;
+#if IPC_CRC32_SLICE == 4
+    uint16_t w1;
+
+    for (; n >= 2; n -= 2)
+    {
+        w0 = *from++;
+        w1 = *from++;
+        *to++ = w0;
+        *to++ = w1;
+        IPC_CRC32_DWORD(crc, w0, w1);
+    }
+#endif
+    for (; n; n--)
+    {
+        w0 = *from++;
+        *to++ = w0;
+        IPC_CRC32_WORD(crc, w0);
+    }
+
+    return crc;
+#endif
+}
+
+#if !APIPC_POSIX
+
+/** driver PutBuffer indexes wrap mask */
+#define IPC_PUT_INDEX_MASK (IPC_BUFFER_SIZE - 1)
+
+/*
+ * IpcPutNoFlag() - put a message on the controller PutBuffer as IpcPut() does,
+ *                  without setting the controller put flag
+ */
+uint16_t IpcPutNoFlag(volatile tIpcController *psController,
+                      tIpcMessage *psMessage, uint16_t bBlock)
+{
+    volatile uint16_t *pusWriteIndex;
+    volatile uint16_t *pusReadIndex;
+    uint16_t writeIndex;
+
+    pusWriteIndex = (volatile uint16_t *)psController->pusPutWriteIndex;
+    pusReadIndex = (volatile uint16_t *)psController->pusPutReadIndex;
+    writeIndex = *pusWriteIndex;
+
+    /* wait until a Put Buffer slot is free */
+    while(((writeIndex + 1) & IPC_PUT_INDEX_MASK) == *pusReadIndex)
+    {
+        if(bBlock == DISABLE_BLOCKING)
+            return STATUS_FAIL;
+    }
+
+    psController->psPutBuffer[writeIndex] = *psMessage;
+
+    /* MSGRAM writes complete in order, the message is there before the
+     * remote core sees the index */
+    *pusWriteIndex = (writeIndex + 1) & IPC_PUT_INDEX_MASK;
+
+    return STATUS_PASS;
+}
+
+/*
+ * IpcPutFree() - free slots of the controller PutBuffer
+ */
+uint16_t IpcPutFree(volatile tIpcController *psController)
+{
+    uint16_t writeIndex;
+    uint16_t readIndex;
+
+    writeIndex = *(volatile uint16_t *)psController->pusPutWriteIndex;
+    readIndex = *(volatile uint16_t *)psController->pusPutReadIndex;
+
+    return (readIndex - writeIndex - 1) & IPC_PUT_INDEX_MASK;
+}
+
+#endif
+
+#if defined(CPU1) && !APIPC_POSIX
 
 /*
  * GSxM_Acces() - Master CPU Configures master R/W/Exe Access to Shared SARAM
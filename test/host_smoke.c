@@ -0,0 +1,191 @@
+/**
+ *
+ * \file host_smoke.c
+ *
+ * \brief apipc host build smoke test.
+ *
+ * \author Federico David Ceccarelli
+ *
+ * CPU1 writes a DATA, apipc_send_isr() put too, a BLOCK modified while its
+ * staging copy is split, a streamed BLOCK and a FLAGS obj and calls a remote
+ * procedure on CPU2, CPU2 writes a BLOCK back. Every core checks what landed
+ * on his objs, the objs went back to idle and the staging spaces were freed.
+ *
+ */
+
+#include "host_test.h"
+
+#define SMOKE_SHM "/apipc_host_smoke"
+
+#define SMOKE_DATA 0 /**< CPU1 -> CPU2 DATA obj */
+#define SMOKE_BLOCK 1 /**< CPU1 -> CPU2 BLOCK obj, streamed */
+#define SMOKE_FLAGS 2 /**< CPU1 -> CPU2 FLAGS obj */
+#define SMOKE_BACK 3 /**< CPU2 -> CPU1 BLOCK obj */
+#define SMOKE_SPLIT 4 /**< CPU1 -> CPU2 BLOCK obj, staged on budgeted calls */
+
+#define SMOKE_FN_SUM 0 /**< CPU2 procedure, sums his arguments */
+
+#define SMOKE_BLOCK_WORDS (APIPC_STREAM_CHUNK + 88)
+#define SMOKE_BACK_WORDS 100
+#define SMOKE_SPLIT_WORDS (APIPC_STAGE_CHUNK * 4)
+
+#define SMOKE_WAIT IPC_TIMER_WAIT_2S
+
+static uint32_t data;
+static uint16_t block[SMOKE_BLOCK_WORDS];
+static uint32_t flags;
+static uint16_t back[SMOKE_BACK_WORDS];
+static uint16_t split[SMOKE_SPLIT_WORDS];
+
+/* smoke_landed - 1 once every remote written obj holds the expected values */
+static uint16_t smoke_landed(void)
+{
+    uint16_t idx;
+
+#if defined(CPU1)
+    for(idx = 0; idx < SMOKE_BACK_WORDS; idx++)
+        if(back[idx] != (uint16_t)(0x8000 | idx))
+            return 0;
+#else
+    if(data != 0xCAFEBABEUL || flags != 0x00010005UL || split[0] == 0)
+        return 0;
+
+    /* a split staging copy never mixes two versions of the block */
+    for(idx = 0; idx < SMOKE_SPLIT_WORDS; idx++)
+        if(split[idx] != split[0])
+            return 0;
+
+    for(idx = 0; idx < SMOKE_BLOCK_WORDS; idx++)
+        if(block[idx] != (uint16_t)(idx * 3))
+            return 0;
+#endif
+
+    return 1;
+}
+
+#if defined(CPU2)
+/* smoke_sum - remote procedure, returns the sum of his arguments */
+static uint16_t smoke_sum(const uint16_t *args, uint16_t args_len,
+                          uint16_t *ret, uint16_t ret_max)
+{
+    uint16_t idx;
+
+    if(ret_max < 1)
+        return 0;
+
+    ret[0] = 0;
+    for(idx = 0; idx < args_len; idx++)
+        ret[0] += args[idx];
+
+    return 1;
+}
+#endif
+
+int main(void)
+{
+    struct apipc_stats st;
+    uint64_t start;
+    uint16_t idx;
+#if defined(CPU1)
+    uint16_t args[4] = {1, 2, 3, 4};
+    uint16_t sum;
+    uint16_t ret_len;
+    uint16_t handle;
+    enum apipc_rc rc;
+#endif
+
+    ht_open(SMOKE_SHM);
+
+    HT_CHECK(apipc_register_obj(SMOKE_DATA, APIPC_OBJ_TYPE_DATA, &data, HT_WORDS(data), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SMOKE_BLOCK, APIPC_OBJ_TYPE_BLOCK, block, HT_WORDS(block), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SMOKE_FLAGS, APIPC_OBJ_TYPE_FLAGS, &flags, HT_WORDS(flags), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SMOKE_BACK, APIPC_OBJ_TYPE_BLOCK, back, HT_WORDS(back), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SMOKE_SPLIT, APIPC_OBJ_TYPE_BLOCK, split, HT_WORDS(split), 0) == APIPC_RC_SUCCESS);
+
+#if defined(CPU1)
+    data = 0xCAFEBABEUL;
+    flags = 0x00010000UL;
+    for(idx = 0; idx < SMOKE_BLOCK_WORDS; idx++)
+        block[idx] = (uint16_t)(idx * 3);
+
+    /* apipc_send() of an obj apipc_send_isr() put holds no second lane slot,
+     * leaked ones would run the lanes out of budget */
+    HT_CHECK(apipc_obj_set_isr_push(SMOKE_DATA, 1) == APIPC_RC_SUCCESS);
+
+    for(idx = 0; idx < 4 * APIPC_LANE_BUDGET; idx++)
+    {
+        HT_CHECK(apipc_send_isr(SMOKE_DATA) == APIPC_RC_SUCCESS);
+        HT_CHECK(ht_send(SMOKE_DATA, SMOKE_WAIT));
+    }
+
+    HT_CHECK(ht_send(SMOKE_DATA, SMOKE_WAIT));
+
+    /* a 1 tick budget pauses the staging copy after every chunk, the block
+     * changes meanwhile so the copy is started again whole */
+    HT_CHECK(ht_idle(SMOKE_SPLIT, SMOKE_WAIT));
+    HT_CHECK(apipc_send(SMOKE_SPLIT) == APIPC_RC_SUCCESS);
+
+    start = ipc_read_timer();
+    while(apipc_obj_state(SMOKE_SPLIT) != APIPC_OBJ_SM_IDLE &&
+          !ipc_timer_expired(start, SMOKE_WAIT))
+    {
+        for(idx = 0; idx < SMOKE_SPLIT_WORDS; idx++)
+            split[idx]++;
+
+        apipc_app_budgeted(1);
+        sched_yield();
+    }
+
+    HT_CHECK(apipc_obj_state(SMOKE_SPLIT) == APIPC_OBJ_SM_IDLE);
+    HT_CHECK(apipc_stats(&st, 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(st.stage_restart > 0);
+
+    HT_CHECK(ht_send(SMOKE_BLOCK, SMOKE_WAIT));
+
+    /* the bits land after the keyed value put right before them */
+    HT_CHECK(apipc_send_now(SMOKE_FLAGS) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_flags_set_bits(SMOKE_FLAGS, 0x0005UL) == APIPC_RC_SUCCESS);
+    HT_CHECK(ht_idle(SMOKE_FLAGS, SMOKE_WAIT));
+
+    /* the procedure could be registered on CPU2 after apipc_init() */
+    start = ipc_read_timer();
+    do
+    {
+        sum = 0;
+        handle = apipc_rpc_call(SMOKE_FN_SUM, args, HT_WORDS(args), &sum, HT_WORDS(sum));
+        HT_CHECK(handle != APIPC_RPC_HANDLE_NONE);
+
+        while((rc = apipc_rpc_status(handle, &ret_len)) == APIPC_RC_PENDING)
+            ht_step();
+    } while(rc != APIPC_RC_SUCCESS && !ipc_timer_expired(start, SMOKE_WAIT));
+
+    HT_CHECK(rc == APIPC_RC_SUCCESS);
+    HT_CHECK(ret_len == 1 && sum == 10);
+#else
+    HT_CHECK(apipc_rpc_register(SMOKE_FN_SUM, smoke_sum) == APIPC_RC_SUCCESS);
+
+    for(idx = 0; idx < SMOKE_BACK_WORDS; idx++)
+        back[idx] = (uint16_t)(0x8000 | idx);
+
+    HT_CHECK(ht_send(SMOKE_BACK, SMOKE_WAIT));
+#endif
+
+    start = ipc_read_timer();
+    while(!smoke_landed() && !ipc_timer_expired(start, SMOKE_WAIT))
+        ht_step();
+
+    HT_CHECK(smoke_landed());
+
+    /* late responses & result releases settle */
+    ht_run(IPC_TIMER_WAIT_100mS);
+
+    HT_CHECK(apipc_stats(&st, 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(st.fail == 0);
+    HT_CHECK(st.stage_live == 0);
+
+    return ht_close("host_smoke");
+}
+
+//
+// End of file.
+//
@@ -0,0 +1,140 @@
+/**
+ *
+ * \file host_test.h
+ *
+ * \brief apipc host tests common helpers.
+ *
+ * \author Federico David Ceccarelli
+ *
+ * Host tests are built on APIPC_POSIX=1 builds, once with -DCPU1 and once with
+ * -DCPU2, and run_pair.sh runs both processes against each other. Every test
+ * returns 0 from main() if every check passed.
+ *
+ */
+
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+
+#include "ipc.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/** registration size of x, the C28x sizeof() counts 16-bit words */
+#define HT_WORDS(x) (sizeof(x) / sizeof(uint16_t))
+
+/** messages apipc_poll() takes per loop on APIPC_POLLED builds */
+#define HT_POLL_MSGS 16
+
+/** failed checks count, main() returns it */
+static int ht_failed;
+
+/** check a condition, report it if it doesn't hold but keep running */
+#define HT_CHECK(cond) \
+    do { \
+        if(!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            ht_failed++; \
+        } \
+    } while(0)
+
+#if defined(CPU1)
+#define HT_CPU "CPU1"
+#else
+#define HT_CPU "CPU2"
+#endif
+
+/* ht_map - map the segment and hook the interrupts, apipc isn't init yet */
+static inline void ht_map(const char *name)
+{
+    while(ipc_posix_open(name) != 0)
+        usleep(1000);
+
+    ipc_posix_isr(IPC_INT0, apipc_ipc0_isr_handler);
+    ipc_posix_isr(IPC_INT1, apipc_ipc1_isr_handler);
+    ipc_posix_isr(IPC_INT2, apipc_ipc2_isr_handler);
+}
+
+/* ht_open - map the segment, hook the interrupts and init apipc */
+static inline void ht_open(const char *name)
+{
+    ht_map(name);
+
+    apipc_init();
+}
+
+/* ht_step - one main loop pass. Both cores may share a host CPU, the pass
+ * gives it away so the remote one is not starved into timeouts */
+static inline void ht_step(void)
+{
+#if APIPC_POLLED
+    apipc_poll(HT_POLL_MSGS);
+#endif
+    apipc_app();
+
+    sched_yield();
+}
+
+/* ht_run - run the main loop for ticks */
+static inline void ht_run(uint64_t ticks)
+{
+    uint64_t start;
+
+    start = ipc_read_timer();
+
+    while(!ipc_timer_expired(start, ticks))
+        ht_step();
+}
+
+/* ht_idle - run the main loop until obj_idx is done, 1 if it went idle */
+static inline uint16_t ht_idle(uint16_t obj_idx, uint64_t ticks)
+{
+    uint64_t start;
+
+    start = ipc_read_timer();
+
+    while(apipc_obj_state(obj_idx) != APIPC_OBJ_SM_IDLE)
+    {
+        if(apipc_obj_state(obj_idx) == APIPC_OBJ_SM_FAIL ||
+           ipc_timer_expired(start, ticks))
+            return 0;
+
+        ht_step();
+    }
+
+    return 1;
+}
+
+/* ht_send - transmit obj_idx once it is idle, 1 if the remote core got it */
+static inline uint16_t ht_send(uint16_t obj_idx, uint64_t ticks)
+{
+    if(!ht_idle(obj_idx, ticks))
+        return 0;
+
+    if(apipc_send(obj_idx) == APIPC_RC_FAIL)
+        return 0;
+
+    return ht_idle(obj_idx, ticks);
+}
+
+/* ht_close - let the remote core finish, release the segment and report */
+static inline int ht_close(const char *test)
+{
+    /* remote transmitions still waiting a response are served meanwhile */
+    ht_run(IPC_TIMER_WAIT_200mS);
+
+    ipc_posix_close();
+
+    printf("%s %s: %s\n", test, HT_CPU, ht_failed ? "FAIL" : "PASS");
+
+    return ht_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif
+
+//
+// End of file.
+//
@@ -0,0 +1,25 @@
+#!/bin/sh
+#
+# run_pair.sh - run a host test CPU1 & CPU2 processes against each other
+#
+# usage: run_pair.sh <cpu1 binary> <cpu2 binary> [test args]
+#
+# Both processes get the same arguments. Exits 0 only if both passed.
+#
+
+cpu1=$1
+cpu2=$2
+shift 2
+
+wait_s=${APIPC_TEST_TIMEOUT:-120}
+
+timeout "$wait_s" "$cpu1" "$@" &
+pid1=$!
+
+timeout "$wait_s" "$cpu2" "$@"
+rc2=$?
+
+wait "$pid1"
+rc1=$?
+
+[ "$rc1" -eq 0 ] && [ "$rc2" -eq 0 ]
@@ -0,0 +1,382 @@
+/**
+ *
+ * \file scaling.c
+ *
+ * \brief apipc host links scaling test.
+ *
+ * \author Federico David Ceccarelli
+ *
+ * CPU1 & CPU2 are connected by SCALE_LINKS links. APIPC_LINK_0 runs over the
+ * port segment, the additional ones over a second segment this test lays out
+ * as a port would: objs tables, credits, lane rings and staging pool of every
+ * core. The lanes of every additional link are served by a thread of his own,
+ * as his own interrupt would, while APIPC_LINK_0 keeps the port interrupt
+ * thread.
+ *
+ * CPU1 transmits a BLOCK obj per link, links are added one per phase and the
+ * goodput of every link is measured. Adding a link should neither collapse
+ * the aggregate goodput, SCALE_DIV of the one link goodput at least, nor
+ * starve a link, every one should get SCALE_DIV of his fair share at least.
+ * The aggregate isn't required to grow, hosts with fewer CPUs than threads
+ * can't run the links in parallel.
+ *
+ */
+
+#include "host_test.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if APIPC_MAX_LINK < 2
+#error "scaling test needs APIPC_MAX_LINK > 1"
+#endif
+
+#define SCALE_SHM "/apipc_scaling"
+#define SCALE_LINKS_SHM "/apipc_scaling_links"
+
+/** additional links segment mapping address, the same on both processes */
+#define SCALE_BASE 0x58000000UL
+
+#define SCALE_LINKS APIPC_MAX_LINK
+#define SCALE_DONE SCALE_LINKS /**< CPU1 -> CPU2 DATA obj, the run is over */
+#define SCALE_DONE_MAGIC 0x5CA1AB1EUL
+
+#define SCALE_WORDS 64 /**< every link BLOCK obj length */
+#define SCALE_POOL_WORDS 0x0800 /**< additional links staging pools length */
+
+#define SCALE_SETTLE IPC_TIMER_WAIT_100mS /**< both cores register their objs */
+#define SCALE_PHASE IPC_TIMER_WAIT_200mS /**< every phase length */
+#define SCALE_WAIT IPC_TIMER_WAIT_2S /**< CPU2 waits CPU1 phases & the end */
+
+#define SCALE_DIV 2
+
+/** additional links lanes interrupt flags, over the ones apipc uses */
+#define SCALE_FLAG(link, lane) (IPC_FLAG8 << (2 * ((link) - 1) + (lane)))
+
+/** spaces a core owns on an additional link */
+struct scale_core
+{
+    struct apipc_obj obj[APIPC_MAX_OBJ]; /**< objs table, read by the peer */
+    struct apipc_credit credit; /**< credits, read by the peer */
+    struct ipc_posix_ring ring[APIPC_MAX_LANE]; /**< received messages */
+    IPC_POSIX_GSRAM_ALIGN uint16_t pool[SCALE_POOL_WORDS]; /**< staging pool */
+};
+
+/** additional links segment, CPU1 & CPU2 spaces of links 1 up to
+ * SCALE_LINKS - 1 */
+struct scale_shm
+{
+    struct scale_core core[SCALE_LINKS - 1][2];
+};
+
+#define SCALE_CORE(link, n) \
+    (&((struct scale_shm *)SCALE_BASE)->core[(link) - 1][n])
+
+static tIpcController scale_ctrl[SCALE_LINKS][APIPC_MAX_LANE];
+static pthread_t scale_thread[SCALE_LINKS];
+static volatile int scale_stop;
+
+static uint16_t block[SCALE_LINKS][SCALE_WORDS];
+static uint32_t done;
+
+/* scale_map - map the additional links segment, CPU1 creates it clean */
+static void scale_map(void)
+{
+    struct stat st;
+    void *p;
+    int fd;
+
+#if defined(CPU1)
+    shm_unlink(SCALE_LINKS_SHM);
+    fd = shm_open(SCALE_LINKS_SHM, O_CREAT | O_EXCL | O_RDWR, 0600);
+    HT_CHECK(fd >= 0 && ftruncate(fd, sizeof(struct scale_shm)) == 0);
+#else
+    /* CPU1 created it before his port segment */
+    fd = shm_open(SCALE_LINKS_SHM, O_RDWR, 0600);
+    HT_CHECK(fd >= 0 && fstat(fd, &st) == 0 &&
+             (size_t)st.st_size >= sizeof(struct scale_shm));
+#endif
+    (void)st;
+
+    p = mmap((void *)SCALE_BASE, sizeof(struct scale_shm), PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    close(fd);
+
+    if(p != (void *)SCALE_BASE)
+    {
+        fprintf(stderr, "%s: links segment not mapped at %#lx\n", HT_CPU, SCALE_BASE);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* scale_register - bind the additional links controllers to their rings and
+ * register the links */
+static void scale_register(void)
+{
+    struct apipc_link_cfg cfg;
+    struct scale_core *plocal;
+    struct scale_core *premote;
+    tIpcController *pctrl;
+    uint16_t link;
+    uint16_t lane;
+
+    for(link = 1; link < SCALE_LINKS; link++)
+    {
+        plocal = SCALE_CORE(link, IPC_POSIX_LOCAL);
+        premote = SCALE_CORE(link, IPC_POSIX_REMOTE);
+
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.l_obj = plocal->obj;
+        cfg.r_obj = premote->obj;
+        cfg.pdata = plocal->pool;
+        cfg.data_len = SCALE_POOL_WORDS;
+        cfg.l_credit = &plocal->credit;
+        cfg.r_credit = &premote->credit;
+
+        for(lane = 0; lane < APIPC_MAX_LANE; lane++)
+        {
+            pctrl = &scale_ctrl[link][lane];
+            pctrl->psPutBuffer = premote->ring[lane].msg;
+            pctrl->ulPutFlag = SCALE_FLAG(link, lane);
+            pctrl->pusPutWriteIndex = &premote->ring[lane].windex;
+            pctrl->pusPutReadIndex = &premote->ring[lane].rindex;
+            pctrl->psGetBuffer = plocal->ring[lane].msg;
+            pctrl->pusGetWriteIndex = &plocal->ring[lane].windex;
+            pctrl->pusGetReadIndex = &plocal->ring[lane].rindex;
+
+            cfg.pctrl[lane] = pctrl;
+            cfg.irq_flag[lane] = SCALE_FLAG(link, lane);
+        }
+
+        HT_CHECK(apipc_link_register(link, &cfg) == APIPC_RC_SUCCESS);
+    }
+}
+
+/* scale_irq - an additional link interrupt, drains his lanes once their flag
+ * is set */
+static void *scale_irq(void *arg)
+{
+    uint16_t link;
+    uint16_t lane;
+    uint16_t got;
+    uint16_t key;
+
+    link = (uint16_t)(uintptr_t)arg;
+
+    while(!__atomic_load_n(&scale_stop, __ATOMIC_ACQUIRE))
+    {
+        got = 0;
+
+        for(lane = 0; lane < APIPC_MAX_LANE; lane++)
+        {
+            if(!IPCRtoLFlagBusy(SCALE_FLAG(link, lane)))
+                continue;
+
+            /* acknowledged first, a message put meanwhile sets it again */
+            key = __disable_interrupts();
+            IPCRtoLFlagAcknowledge(SCALE_FLAG(link, lane));
+            apipc_link_drain(link, (enum apipc_lane_id)lane);
+            __restore_interrupts(key);
+
+            got = 1;
+        }
+
+        /* the CPU is given away while the lanes are empty */
+        if(!got)
+            sched_yield();
+    }
+
+    return NULL;
+}
+
+#if defined(CPU1)
+/* scale_fill - every link block holds his own pattern */
+static void scale_fill(uint16_t *p, uint16_t link)
+{
+    uint16_t idx;
+
+    for(idx = 0; idx < SCALE_WORDS; idx++)
+        p[idx] = (uint16_t)((link << 12) | idx);
+}
+
+/* scale_phase - transmit the blocks of the first links for SCALE_PHASE,
+ * words gets every link goodput in words per second */
+static void scale_phase(uint16_t links, uint32_t *words)
+{
+    uint16_t sent[SCALE_LINKS];
+    enum apipc_obj_sm state;
+    uint64_t start;
+    uint16_t link;
+
+    memset(sent, 0, sizeof(sent));
+
+    for(link = 0; link < links; link++)
+        words[link] = 0;
+
+    start = ipc_read_timer();
+
+    while(!ipc_timer_expired(start, SCALE_PHASE))
+    {
+        for(link = 0; link < links; link++)
+        {
+            state = apipc_obj_state(link);
+
+            if(state == APIPC_OBJ_SM_FAIL)
+                sent[link] = 0;
+
+            if(state != APIPC_OBJ_SM_IDLE)
+                continue;
+
+            /* an obj back to idle after his send was acknowledged */
+            if(sent[link])
+                words[link] += SCALE_WORDS;
+
+            sent[link] = (apipc_send(link) != APIPC_RC_FAIL);
+        }
+
+        ht_step();
+    }
+
+    /* transmitions still going aren't counted */
+    for(link = 0; link < links; link++)
+    {
+        HT_CHECK(ht_idle(link, SCALE_PHASE));
+        words[link] = (uint32_t)((uint64_t)words[link] * IPC_TIMER_WAIT_1S / SCALE_PHASE);
+    }
+}
+#else
+/* scale_match - 1 if a link block holds his pattern */
+static uint16_t scale_match(const uint16_t *p, uint16_t link)
+{
+    uint16_t idx;
+
+    for(idx = 0; idx < SCALE_WORDS; idx++)
+        if(p[idx] != (uint16_t)((link << 12) | idx))
+            return 0;
+
+    return 1;
+}
+#endif
+
+int main(void)
+{
+    struct apipc_stats st;
+    uint16_t link;
+    int rc;
+#if defined(CPU1)
+    uint32_t words[SCALE_LINKS];
+    uint32_t total;
+    uint32_t total_one;
+    uint32_t least;
+    uint16_t links;
+#else
+    uint64_t start;
+#endif
+
+    /* CPU2 attaches to the port segment once CPU1 created both */
+#if defined(CPU1)
+    scale_map();
+    ht_map(SCALE_SHM);
+#else
+    ht_map(SCALE_SHM);
+    scale_map();
+#endif
+
+    scale_register();
+    apipc_init();
+
+    for(link = 1; link < SCALE_LINKS; link++)
+        HT_CHECK(pthread_create(&scale_thread[link], NULL, scale_irq,
+                                (void *)(uintptr_t)link) == 0);
+
+    /* one BLOCK obj per link, obj indexes are shared by every link */
+    for(link = 0; link < SCALE_LINKS; link++)
+    {
+        if(link != APIPC_LINK_0)
+            HT_CHECK(apipc_obj_set_link(link, link) == APIPC_RC_SUCCESS);
+
+        HT_CHECK(apipc_register_obj(link, APIPC_OBJ_TYPE_BLOCK, block[link], HT_WORDS(block[link]), 0) == APIPC_RC_SUCCESS);
+    }
+
+    HT_CHECK(apipc_register_obj(SCALE_DONE, APIPC_OBJ_TYPE_DATA, &done, HT_WORDS(done), 0) == APIPC_RC_SUCCESS);
+
+    ht_run(SCALE_SETTLE);
+
+#if defined(CPU1)
+    for(link = 0; link < SCALE_LINKS; link++)
+        scale_fill(block[link], link);
+
+    total_one = 0;
+
+    for(links = 1; links <= SCALE_LINKS; links++)
+    {
+        scale_phase(links, words);
+
+        total = 0;
+        least = words[0];
+
+        for(link = 0; link < links; link++)
+        {
+            total += words[link];
+            if(words[link] < least)
+                least = words[link];
+        }
+
+        if(links == 1)
+            total_one = total;
+
+        printf("scaling %s: %u links, goodput %lu words/s, per link", HT_CPU,
+               links, (unsigned long)total);
+        for(link = 0; link < links; link++)
+            printf(" %lu", (unsigned long)words[link]);
+        printf("\n");
+
+        /* the aggregate holds and every link gets his share */
+        HT_CHECK(least > 0);
+        HT_CHECK((uint64_t)total * SCALE_DIV >= total_one);
+        HT_CHECK((uint64_t)least * links * SCALE_DIV >= total);
+    }
+
+    done = SCALE_DONE_MAGIC;
+    HT_CHECK(ht_send(SCALE_DONE, SCALE_WAIT));
+#else
+    start = ipc_read_timer();
+    while(done != SCALE_DONE_MAGIC &&
+          !ipc_timer_expired(start, SCALE_WAIT + SCALE_LINKS * SCALE_PHASE))
+        ht_step();
+
+    HT_CHECK(done == SCALE_DONE_MAGIC);
+
+    /* every link landed his own pattern */
+    for(link = 0; link < SCALE_LINKS; link++)
+        HT_CHECK(scale_match(block[link], link));
+#endif
+
+    /* late responses settle while the link threads still run */
+    ht_run(SCALE_SETTLE);
+
+    HT_CHECK(apipc_stats(&st, 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(st.fail == 0);
+    HT_CHECK(st.stage_live == 0);
+
+    __atomic_store_n(&scale_stop, 1, __ATOMIC_RELEASE);
+
+    for(link = 1; link < SCALE_LINKS; link++)
+        pthread_join(scale_thread[link], NULL);
+
+    rc = ht_close("scaling");
+
+    munmap((void *)SCALE_BASE, sizeof(struct scale_shm));
+#if defined(CPU1)
+    shm_unlink(SCALE_LINKS_SHM);
+#endif
+
+    return rc;
+}
+
+//
+// End of file.
+//
@@ -0,0 +1,464 @@
+/**
+ *
+ * \file soak.c
+ *
+ * \brief apipc host soak test, sustained traffic under injected faults.
+ *
+ * \author Federico David Ceccarelli
+ *
+ * Both cores keep transmitting DATA, FLAGS, BLOCK, leased and streamed BLOCK
+ * objs at SOAK_PERIOD, and CPU1 keeps a remote procedure call going. CPU2
+ * checks every leased block he acquires is whole, copied blocks are written
+ * by the ISR while the main loop runs so they are only checked once final.
+ * The run has three phases:
+ *
+ * - clean: no faults, the goodput baseline is measured.
+ * - faulty: every received message, commands and responses alike, may be
+ *   dropped, duplicated or delayed, which reorders it. The goodput should
+ *   hold at least 1 / SOAK_GOODPUT_DIV of the baseline.
+ * - final: faults stop, every obj is transmitted once more with known values
+ *   that have to land. Once quiet, the cl_r_w_data staging spaces should be
+ *   back to baseline and no recovery should have taken over
+ *   SOAK_RECOVERY_MAX.
+ *
+ */
+
+#include "host_test.h"
+
+#define SOAK_SHM "/apipc_soak"
+
+#define SOAK_DATA 0 /**< CPU1 -> CPU2 DATA obj */
+#define SOAK_FLAGS 1 /**< CPU1 -> CPU2 FLAGS obj */
+#define SOAK_BLOCK 2 /**< CPU1 -> CPU2 BLOCK obj */
+#define SOAK_LEASE 3 /**< CPU1 -> CPU2 BLOCK obj, leased by CPU2 */
+#define SOAK_STREAM 4 /**< CPU1 -> CPU2 BLOCK obj, streamed */
+#define SOAK_BACK 5 /**< CPU2 -> CPU1 BLOCK obj */
+#define SOAK_BACK_DATA 6 /**< CPU2 -> CPU1 DATA obj */
+#define SOAK_OBJS 7
+
+#define SOAK_FN_SUM 0 /**< CPU2 procedure, sums his arguments */
+
+#define SOAK_BLOCK_WORDS 64
+#define SOAK_LEASE_WORDS 32
+#define SOAK_STREAM_WORDS (APIPC_STREAM_CHUNK + 40)
+
+#define SOAK_PERIOD IPC_TIMER_WAIT_1mS /**< ticks between an obj transmitions */
+#define SOAK_CLEAN IPC_TIMER_WAIT_200mS /**< clean phase length */
+#define SOAK_FAULTY IPC_TIMER_WAIT_1S /**< faulty phase length */
+#define SOAK_SETTLE IPC_TIMER_WAIT_100mS /**< held messages & late responses settle */
+#define SOAK_WAIT IPC_TIMER_WAIT_2S /**< final values landing limit */
+#define SOAK_QUIET IPC_TIMER_WAIT_500mS /**< staging spaces release limit */
+
+#define SOAK_DROP 20 /**< per mille of received messages dropped */
+#define SOAK_DUP 10 /**< per mille of received messages duplicated */
+#define SOAK_DELAY 20 /**< per mille of received messages delayed */
+
+#define SOAK_GOODPUT_DIV 4
+#define SOAK_RECOVERY_MAX IPC_TIMER_WAIT_100mS
+
+#define SOAK_FINAL 0xF00D /**< final transmitions sequence number */
+#define SOAK_FINAL_BITS 0x00A5UL /**< final FLAGS bits, set after his value */
+
+static uint32_t data;
+static uint32_t flags;
+static uint16_t block[SOAK_BLOCK_WORDS];
+static uint16_t lease[SOAK_LEASE_WORDS];
+static uint16_t stream[SOAK_STREAM_WORDS];
+static uint16_t back[SOAK_BLOCK_WORDS];
+static uint32_t back_data;
+
+static uint16_t faulty;
+static uint32_t rnd;
+
+static uint16_t seq[SOAK_OBJS];
+static uint64_t sent[SOAK_OBJS];
+
+/* soak_rand - xorshift32, each core draws his own sequence */
+static uint32_t soak_rand(void)
+{
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+
+    return rnd;
+}
+
+/* soak_fault - fault hook, faults are injected only on the faulty phase */
+static enum apipc_fault soak_fault(enum apipc_lane_id lane,
+                                   const tIpcMessage *psMessage)
+{
+    uint32_t r;
+
+    if(!faulty)
+        return APIPC_FAULT_NONE;
+
+    r = soak_rand() % 1000;
+
+    if(r < SOAK_DROP)
+        return APIPC_FAULT_DROP;
+
+    if(r < SOAK_DROP + SOAK_DUP)
+        return APIPC_FAULT_DUP;
+
+    if(r < SOAK_DROP + SOAK_DUP + SOAK_DELAY)
+        return APIPC_FAULT_DELAY;
+
+    return APIPC_FAULT_NONE;
+}
+
+/* soak_fill - write a block pattern, his first word is the sequence number */
+static void soak_fill(uint16_t *p, uint16_t len, uint16_t s)
+{
+    uint16_t idx;
+
+    for(idx = 0; idx < len; idx++)
+        p[idx] = (uint16_t)(s + idx);
+}
+
+/* soak_match - 1 if a block holds a whole pattern, 0 if it is torn */
+static uint16_t soak_match(const uint16_t *p, uint16_t len, uint16_t s)
+{
+    uint16_t idx;
+
+    for(idx = 0; idx < len; idx++)
+        if(p[idx] != (uint16_t)(s + idx))
+            return 0;
+
+    return 1;
+}
+
+/* soak_load - load an obj with the values of a sequence number */
+static void soak_load(uint16_t obj_idx, uint16_t s)
+{
+    switch(obj_idx)
+    {
+        case SOAK_DATA:
+            data = ((uint32_t)s << 16) | s;
+            break;
+
+        case SOAK_FLAGS:
+            flags = (uint32_t)s << 16;
+            break;
+
+        case SOAK_BLOCK:
+            soak_fill(block, SOAK_BLOCK_WORDS, s);
+            break;
+
+        case SOAK_LEASE:
+            soak_fill(lease, SOAK_LEASE_WORDS, s);
+            break;
+
+        case SOAK_STREAM:
+            soak_fill(stream, SOAK_STREAM_WORDS, s);
+            break;
+
+        case SOAK_BACK:
+            soak_fill(back, SOAK_BLOCK_WORDS, s);
+            break;
+
+        case SOAK_BACK_DATA:
+            back_data = ((uint32_t)s << 16) | s;
+            break;
+    }
+}
+
+/* soak_own - 1 if obj_idx is transmitted by this core */
+static uint16_t soak_own(uint16_t obj_idx)
+{
+#if defined(CPU1)
+    return obj_idx < SOAK_BACK;
+#else
+    return obj_idx >= SOAK_BACK;
+#endif
+}
+
+/* soak_traffic - transmit every own idle obj once his period is over */
+static void soak_traffic(void)
+{
+    uint16_t obj_idx;
+
+    for(obj_idx = 0; obj_idx < SOAK_OBJS; obj_idx++)
+    {
+        if(!soak_own(obj_idx) || apipc_obj_state(obj_idx) != APIPC_OBJ_SM_IDLE ||
+           !ipc_timer_expired(sent[obj_idx], SOAK_PERIOD))
+            continue;
+
+        /* final sequence number is kept for the last transmition */
+        if(++seq[obj_idx] == SOAK_FINAL)
+            seq[obj_idx] = 0;
+
+        soak_load(obj_idx, seq[obj_idx]);
+        sent[obj_idx] = ipc_read_timer();
+
+        /* random FLAGS bits follow his value on the same lane */
+        if(obj_idx != SOAK_FLAGS)
+            apipc_send(obj_idx);
+        else if(apipc_send_now(obj_idx) == APIPC_RC_SUCCESS)
+            apipc_flags_set_bits(obj_idx, soak_rand() & 0xFFUL);
+    }
+}
+
+#if defined(CPU1)
+static uint16_t rpc_handle = APIPC_RPC_HANDLE_NONE;
+static uint16_t rpc_args[3];
+static uint16_t rpc_sum;
+static uint32_t rpc_done;
+
+/* soak_rpc - keep a remote procedure call going, check every return */
+static void soak_rpc(void)
+{
+    enum apipc_rc rc;
+    uint16_t ret_len;
+
+    if(rpc_handle == APIPC_RPC_HANDLE_NONE)
+    {
+        rpc_args[0] = (uint16_t)soak_rand();
+        rpc_args[1] = (uint16_t)soak_rand();
+        rpc_args[2] = (uint16_t)soak_rand();
+        rpc_sum = 0;
+        rpc_handle = apipc_rpc_call(SOAK_FN_SUM, rpc_args, HT_WORDS(rpc_args),
+                                    &rpc_sum, HT_WORDS(rpc_sum));
+        return;
+    }
+
+    rc = apipc_rpc_status(rpc_handle, &ret_len);
+
+    if(rc == APIPC_RC_PENDING)
+        return;
+
+    /* lost calls time out, a returned one has to be right */
+    if(rc == APIPC_RC_SUCCESS)
+    {
+        HT_CHECK(ret_len == 1 &&
+                 rpc_sum == (uint16_t)(rpc_args[0] + rpc_args[1] + rpc_args[2]));
+        rpc_done++;
+    }
+
+    rpc_handle = APIPC_RPC_HANDLE_NONE;
+}
+
+/* soak_rx - CPU1 objs are read in place, nothing to consume */
+static void soak_rx(void)
+{
+}
+
+/* soak_landed - 1 once CPU2 final transmitions landed */
+static uint16_t soak_landed(void)
+{
+    return back_data == (((uint32_t)SOAK_FINAL << 16) | SOAK_FINAL) &&
+           soak_match(back, SOAK_BLOCK_WORDS, SOAK_FINAL);
+}
+#else
+static uint16_t lease_last;
+static uint32_t lease_done;
+
+/* soak_sum - remote procedure, returns the sum of his arguments */
+static uint16_t soak_sum(const uint16_t *args, uint16_t args_len,
+                         uint16_t *ret, uint16_t ret_max)
+{
+    uint16_t idx;
+
+    if(ret_max < 1)
+        return 0;
+
+    ret[0] = 0;
+    for(idx = 0; idx < args_len; idx++)
+        ret[0] += args[idx];
+
+    return 1;
+}
+
+/* soak_rx - consume the leased blocks, they are never torn */
+static void soak_rx(void)
+{
+    const uint16_t *p;
+
+    p = (const uint16_t *)apipc_lease_acquire(SOAK_LEASE);
+
+    if(p != NULL)
+    {
+        HT_CHECK(soak_match(p, SOAK_LEASE_WORDS, p[0]));
+        lease_last = p[0];
+        lease_done++;
+        apipc_lease_release(SOAK_LEASE);
+    }
+}
+
+/* soak_landed - 1 once CPU1 final transmitions landed */
+static uint16_t soak_landed(void)
+{
+    return data == (((uint32_t)SOAK_FINAL << 16) | SOAK_FINAL) &&
+           flags == (((uint32_t)SOAK_FINAL << 16) | SOAK_FINAL_BITS) &&
+           soak_match(block, SOAK_BLOCK_WORDS, SOAK_FINAL) &&
+           soak_match(stream, SOAK_STREAM_WORDS, SOAK_FINAL) &&
+           (lease_last == SOAK_FINAL ||
+            soak_match(lease, SOAK_LEASE_WORDS, SOAK_FINAL));
+}
+#endif
+
+/* soak_phase - run the traffic for ticks, returns the goodput words */
+static uint32_t soak_phase(uint64_t ticks)
+{
+    struct apipc_stats st;
+    uint32_t words;
+    uint64_t start;
+
+    apipc_stats(&st, 0);
+    words = st.tx_words;
+    start = ipc_read_timer();
+
+    while(!ipc_timer_expired(start, ticks))
+    {
+        soak_traffic();
+#if defined(CPU1)
+        soak_rpc();
+#endif
+        ht_step();
+        soak_rx();
+    }
+
+    apipc_stats(&st, 0);
+
+    return st.tx_words - words;
+}
+
+/* soak_final - transmit every own obj with the final values & wait the remote
+ * ones, 1 if everything landed */
+static uint16_t soak_final(void)
+{
+    enum soak_final_step { SOAK_TODO = 0, SOAK_SENT, SOAK_DONE };
+    enum soak_final_step step[SOAK_OBJS] = {SOAK_TODO};
+    enum apipc_obj_sm state;
+    uint16_t obj_idx;
+    uint16_t left;
+    uint64_t start;
+
+    start = ipc_read_timer();
+
+    do
+    {
+        left = 0;
+
+        for(obj_idx = 0; obj_idx < SOAK_OBJS; obj_idx++)
+        {
+            if(!soak_own(obj_idx) || step[obj_idx] == SOAK_DONE)
+                continue;
+
+            left++;
+            state = apipc_obj_state(obj_idx);
+
+            /* a failed final transmition is tried again */
+            if(state == APIPC_OBJ_SM_FAIL)
+                step[obj_idx] = SOAK_TODO;
+
+            if(state != APIPC_OBJ_SM_IDLE)
+                continue;
+
+            if(step[obj_idx] == SOAK_TODO)
+            {
+                soak_load(obj_idx, SOAK_FINAL);
+                if(apipc_send(obj_idx) != APIPC_RC_FAIL)
+                    step[obj_idx] = SOAK_SENT;
+            }
+            /* FLAGS bits go once his value was acknowledged */
+            else if(obj_idx != SOAK_FLAGS ||
+                    apipc_flags_set_bits(obj_idx, SOAK_FINAL_BITS) == APIPC_RC_SUCCESS)
+                step[obj_idx] = SOAK_DONE;
+        }
+
+        ht_step();
+        soak_rx();
+
+        if(!left && soak_landed())
+            return 1;
+
+    } while(!ipc_timer_expired(start, SOAK_WAIT));
+
+    return 0;
+}
+
+int main(void)
+{
+    struct apipc_stats st;
+    uint16_t stage_base;
+    uint32_t clean;
+    uint32_t loaded;
+    uint64_t start;
+
+    ht_open(SOAK_SHM);
+
+    apipc_stats(&st, 0);
+    stage_base = st.stage_live;
+
+    HT_CHECK(apipc_register_obj(SOAK_DATA, APIPC_OBJ_TYPE_DATA, &data, HT_WORDS(data), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SOAK_FLAGS, APIPC_OBJ_TYPE_FLAGS, &flags, HT_WORDS(flags), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SOAK_BLOCK, APIPC_OBJ_TYPE_BLOCK, block, HT_WORDS(block), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SOAK_LEASE, APIPC_OBJ_TYPE_BLOCK, lease, HT_WORDS(lease), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SOAK_STREAM, APIPC_OBJ_TYPE_BLOCK, stream, HT_WORDS(stream), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SOAK_BACK, APIPC_OBJ_TYPE_BLOCK, back, HT_WORDS(back), 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_register_obj(SOAK_BACK_DATA, APIPC_OBJ_TYPE_DATA, &back_data, HT_WORDS(back_data), 0) == APIPC_RC_SUCCESS);
+
+#if defined(CPU1)
+    rnd = 0x12345678UL;
+#else
+    rnd = 0x9ABCDEF0UL;
+    HT_CHECK(apipc_rpc_register(SOAK_FN_SUM, soak_sum) == APIPC_RC_SUCCESS);
+    HT_CHECK(apipc_obj_set_lease(SOAK_LEASE, 1) == APIPC_RC_SUCCESS);
+#endif
+
+    apipc_fault_register(soak_fault);
+
+    /* baseline */
+    ht_run(SOAK_SETTLE);
+    HT_CHECK(apipc_stats(&st, 1) == APIPC_RC_SUCCESS);
+
+    clean = soak_phase(SOAK_CLEAN);
+
+    faulty = 1;
+    loaded = soak_phase(SOAK_FAULTY);
+    faulty = 0;
+
+    /* goodput per tick holds under loss */
+    HT_CHECK(clean > 0);
+    HT_CHECK((uint64_t)loaded * SOAK_CLEAN * SOAK_GOODPUT_DIV >= (uint64_t)clean * SOAK_FAULTY);
+
+    /* held messages are processed & lost ones recovered before the final
+     * values go */
+    soak_phase(SOAK_SETTLE);
+
+    HT_CHECK(soak_final());
+
+    /* leases still held are given back */
+    start = ipc_read_timer();
+    while(!ipc_timer_expired(start, SOAK_QUIET))
+    {
+        ht_step();
+        soak_rx();
+    }
+
+    HT_CHECK(apipc_stats(&st, 0) == APIPC_RC_SUCCESS);
+    HT_CHECK(st.fault_drop > 0 && st.fault_dup > 0 && st.fault_delay > 0);
+    HT_CHECK(st.retry > 0);
+    HT_CHECK(st.fail * 100 <= st.tx_done);
+    HT_CHECK(st.recovery_max <= SOAK_RECOVERY_MAX);
+    HT_CHECK(st.stage_live == stage_base);
+
+#if defined(CPU1)
+    HT_CHECK(rpc_done > 0);
+#else
+    HT_CHECK(lease_done > 0);
+#endif
+
+    printf("soak %s: goodput clean %lu faulty %lu words/s, recovery max %lu us, "
+           "retry %lu fail %lu\n", HT_CPU,
+           (unsigned long)((uint64_t)clean * IPC_TIMER_WAIT_1S / SOAK_CLEAN),
+           (unsigned long)((uint64_t)loaded * IPC_TIMER_WAIT_1S / SOAK_FAULTY),
+           (unsigned long)(st.recovery_max / (IPC_TIMER_WAIT_1mS / 1000)),
+           (unsigned long)st.retry, (unsigned long)st.fail);
+
+    return ht_close("soak");
+}
+
+//
+// End of file.
+//